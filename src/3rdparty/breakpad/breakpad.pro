@@ -35,6 +35,7 @@ linux {
 
     SOURCES += \
         src/src/client/linux/crash_generation/crash_generation_client.cc \
+        src/src/client/linux/crash_generation/crash_generation_server.cc \
         src/src/client/linux/dump_writer_common/thread_info.cc \
         src/src/client/linux/dump_writer_common/ucontext_reader.cc \
         src/src/client/linux/handler/exception_handler.cc \
@@ -8,32 +8,68 @@ CONFIG -= debug_and_release debug_and_release_target
 INCLUDEPATH += $$system_path($$shadowed(include))
 DEPENDPATH += $$system_path($$shadowed(include))
 
-QT = network qml-private
+QT = concurrent network qml-private
 
 include(../3rdparty/breakpad/breakpad.pri)
 
 HEADERS = \
+    KDHockeyAppBreadcrumbRing_p.h \
+    KDHockeyAppCrashBundle_p.h \
+    KDHockeyAppCrashSignature_p.h \
+    KDHockeyAppCrashSpool_p.h \
     KDHockeyAppLiterals_p.h \
+    KDHockeyAppLogBuffer_p.h \
+    KDHockeyAppLogFormatter_p.h \
     KDHockeyAppManager.h \
     KDHockeyAppManager_p.h \
-    KDHockeyAppSoftAssert_p.h
+    KDHockeyAppQmlStackTrace_p.h \
+    KDHockeyAppSoftAssert_p.h \
+    KDHockeyAppUploadQueue_p.h \
+    KDHockeyAppVersionChecker_p.h
 
 SOURCES = \
+    KDHockeyAppBreadcrumbRing.cpp \
+    KDHockeyAppCrashBundle.cpp \
+    KDHockeyAppCrashSignature.cpp \
+    KDHockeyAppCrashSpool.cpp \
     KDHockeyAppLiterals.cpp \
+    KDHockeyAppLogBuffer.cpp \
+    KDHockeyAppLogFormatter.cpp \
     KDHockeyAppManager.cpp \
-    KDHockeyAppSoftAssert.cpp
+    KDHockeyAppQmlStackTrace.cpp \
+    KDHockeyAppSoftAssert.cpp \
+    KDHockeyAppUploadQueue.cpp \
+    KDHockeyAppVersionChecker.cpp
+
+!CONFIG(disable_compression, enable_compression|disable_compression) {
+    QT_PRIVATE += zlib-private
+
+    HEADERS += \
+        KDHockeyAppGzipDevice_p.h
+
+    SOURCES += \
+        KDHockeyAppGzipDevice.cpp
+}
 
 android {
     QT += androidextras
 
+    HEADERS += \
+        KDHockeyAppMiniDumpPolicy_p.h
+
     SOURCES += \
-        KDHockeyAppManager_android.cpp
+        KDHockeyAppManager_android.cpp \
+        KDHockeyAppMiniDumpPolicy.cpp
 } else: ios: CONFIG(device, device|simulator) {
     OBJECTIVE_SOURCES += \
         KDHockeyAppManager_ios.mm
 } else: linux: {
+    HEADERS += \
+        KDHockeyAppMiniDumpPolicy_p.h
+
     SOURCES += \
-        KDHockeyAppManager_linux.cpp
+        KDHockeyAppManager_linux.cpp \
+        KDHockeyAppMiniDumpPolicy.cpp
 } else {
     SOURCES += \
         KDHockeyAppManager_generic.cpp
@@ -0,0 +1,149 @@
+//
+// Copyright (C) 2017 Klaralvdalens Datakonsult AB, a KDAB Group company, info@kdab.com.
+// All rights reserved.
+//
+// This file is part of the KD HockeyApp library.
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of either:
+//
+//   The GNU Lesser General Public License version 2.1 and version 3
+//   as published by the Free Software Foundation and appearing in the
+//   file LICENSE.LGPL.txt included.
+//
+// Or:
+//
+//   The Mozilla Public License Version 2.0 as published by the Mozilla
+//   Foundation and appearing in the file LICENSE.MPL2.txt included.
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Contact info@kdab.com if any conditions of this licensing is not clear to you.
+//
+
+
+#include "KDHockeyAppBreadcrumbRing_p.h"
+
+#include <QDateTime>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#ifdef Q_CC_MSVC
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef Q_OS_LINUX
+#include <time.h>
+#endif
+
+namespace KDHockeyApp {
+
+namespace {
+
+// Dumps start with this header, followed by the ring's capacity as 32 bit number, the
+// wall-clock time of the ring's creation in milliseconds since the epoch as 64 bit number,
+// and then that many records. All numbers are in host byte order, as the crash handler
+// cannot afford converting them.
+constexpr char s_magic[] = {'K', 'D', 'H', 'A', 'B', 'C', 'R', 'B', 1, 0, 0, 0};
+
+static_assert(sizeof(BreadcrumbRing::Record) == 128, "Breadcrumb records must be exactly 128 bytes");
+static_assert(sizeof(std::atomic<quint64>) == sizeof(quint64), "Breadcrumb sequence numbers must be plain integers");
+
+quint64 ringCapacity(int requested)
+{
+    quint64 capacity = 1;
+
+    while (capacity < static_cast<quint64>(requested))
+        capacity <<= 1;
+
+    return capacity;
+}
+
+bool writeFully(int fd, const void *data, size_t size)
+{
+    auto bytes = static_cast<const char *>(data);
+
+    while (size > 0) {
+        const auto written = write(fd, bytes, static_cast<unsigned>(size));
+
+        if (written <= 0)
+            return false;
+
+        bytes += written;
+        size -= static_cast<size_t>(written);
+    }
+
+    return true;
+}
+
+qint64 monotonicMicroseconds()
+{
+#ifdef CLOCK_MONOTONIC_COARSE
+    // breadcrumbs need no better resolution than the scheduler tick, but reading
+    // the precise clock would be the most expensive part of recording them
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &now);
+    return static_cast<qint64>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+#else
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::microseconds>(now).count();
+#endif
+}
+
+} // namespace
+
+BreadcrumbRing::BreadcrumbRing(int capacity)
+    : m_start{monotonicMicroseconds()}
+    , m_epoch{QDateTime::currentMSecsSinceEpoch()}
+    , m_capacity{ringCapacity(capacity)}
+    , m_records{new Record[m_capacity]()} // value initialization touches the pages in advance
+{}
+
+/*!
+    Records a breadcrumb of \a type with the first \a size bytes of \a text.
+    Texts longer than a record's capacity get truncated.
+*/
+void BreadcrumbRing::append(int type, const char *text, int size)
+{
+    const auto index = m_next.fetch_add(1, std::memory_order_relaxed);
+    auto &record = m_records[index & (m_capacity - 1)];
+
+    record.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    const auto length = std::min<size_t>(static_cast<size_t>(qMax(size, 0)), sizeof record.text);
+
+    record.timestamp = monotonicMicroseconds() - m_start;
+    record.type = static_cast<quint16>(type);
+    record.size = static_cast<quint16>(length);
+    memcpy(record.text, text, length);
+
+    record.sequence.store(index + 1, std::memory_order_release);
+}
+
+/*!
+    Returns the number of bytes written by writeTo().
+*/
+qint64 BreadcrumbRing::dumpSize() const
+{
+    return static_cast<qint64>(sizeof s_magic + sizeof(quint32) + sizeof m_epoch + sizeof(Record) * m_capacity);
+}
+
+bool BreadcrumbRing::writeTo(int fd) const
+{
+    // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
+
+    const auto capacity = static_cast<quint32>(m_capacity);
+
+    return writeFully(fd, s_magic, sizeof s_magic)
+            && writeFully(fd, &capacity, sizeof capacity)
+            && writeFully(fd, &m_epoch, sizeof m_epoch)
+            && writeFully(fd, m_records.get(), sizeof(Record) * m_capacity);
+}
+
+} // namespace KDHockeyApp
@@ -0,0 +1,84 @@
+//
+// Copyright (C) 2017 Klaralvdalens Datakonsult AB, a KDAB Group company, info@kdab.com.
+// All rights reserved.
+//
+// This file is part of the KD HockeyApp library.
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of either:
+//
+//   The GNU Lesser General Public License version 2.1 and version 3
+//   as published by the Free Software Foundation and appearing in the
+//   file LICENSE.LGPL.txt included.
+//
+// Or:
+//
+//   The Mozilla Public License Version 2.0 as published by the Mozilla
+//   Foundation and appearing in the file LICENSE.MPL2.txt included.
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Contact info@kdab.com if any conditions of this licensing is not clear to you.
+//
+
+
+#ifndef KDHOCKEYAPPBREADCRUMBRING_P_H
+#define KDHOCKEYAPPBREADCRUMBRING_P_H
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <memory>
+
+namespace KDHockeyApp {
+
+/**
+ * A multi-producer, lock-free ring of fixed-size breadcrumb records.
+ *
+ * Breadcrumbs are small, typed and timestamped events, like navigation, network
+ * requests and user actions. Writers claim a record with a single atomic increment
+ * and fill it in place, so recording a breadcrumb neither locks nor allocates.
+ * Each record carries a sequence number which is cleared while the record gets
+ * filled, and published afterwards. Records torn by a crash, or by the ring
+ * wrapping while they were written, therefore can be recognized and dropped.
+ *
+ * The crash handler dumps the ring as it is, prefixed by a small header with the
+ * wall-clock time of the ring's creation. Records are stored in host byte order,
+ * which all supported platforms have as little endian. The decodelog tool converts
+ * such dumps into text.
+ */
+class BreadcrumbRing
+{
+public:
+    struct Record
+    {
+        std::atomic<quint64> sequence; // zero for unused and incomplete records
+        qint64 timestamp;              // microseconds since the ring got created
+        quint16 type;
+        quint16 size;
+        quint32 reserved;
+        char text[104];
+    };
+
+    explicit BreadcrumbRing(int capacity = 256);
+
+    void append(int type, const char *text, int size);
+
+    bool isEmpty() const { return m_next.load(std::memory_order_relaxed) == 0; }
+    bool writeTo(int fd) const;
+    qint64 dumpSize() const;
+
+private:
+    Q_DISABLE_COPY(BreadcrumbRing)
+
+    const qint64 m_start;
+    const qint64 m_epoch;
+    const quint64 m_capacity;
+    const std::unique_ptr<Record[]> m_records;
+    std::atomic<quint64> m_next{0};
+};
+
+} // namespace KDHockeyApp
+
+#endif // KDHOCKEYAPPBREADCRUMBRING_P_H
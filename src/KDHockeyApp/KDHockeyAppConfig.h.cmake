@@ -2,5 +2,6 @@
 #define KDHOCKEYAPPCONFIG_H
 
 #cmakedefine KDHOCKEYAPP_QMLSUPPORT_ENABLED
+#cmakedefine KDHOCKEYAPP_COMPRESSION_ENABLED
 
 #endif // KDHOCKEYAPPCONFIG_H
@@ -0,0 +1,233 @@
+//
+// Copyright (C) 2017 Klaralvdalens Datakonsult AB, a KDAB Group company, info@kdab.com.
+// All rights reserved.
+//
+// This file is part of the KD HockeyApp library.
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of either:
+//
+//   The GNU Lesser General Public License version 2.1 and version 3
+//   as published by the Free Software Foundation and appearing in the
+//   file LICENSE.LGPL.txt included.
+//
+// Or:
+//
+//   The Mozilla Public License Version 2.0 as published by the Mozilla
+//   Foundation and appearing in the file LICENSE.MPL2.txt included.
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Contact info@kdab.com if any conditions of this licensing is not clear to you.
+//
+
+
+#include "KDHockeyAppCrashBundle_p.h"
+
+#include <QtEndian>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#ifdef Q_CC_MSVC
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef Q_OS_UNIX
+#include <sys/file.h>
+#endif
+
+namespace KDHockeyApp {
+
+namespace {
+
+constexpr char bundleMagic[8] = {'K', 'D', 'H', 'A', 'C', 'R', 'S', 'H'};
+constexpr int sectionHeaderSize = 8;
+
+} // namespace
+
+CrashBundle::~CrashBundle()
+{
+    remove();
+}
+
+/*!
+    Creates the bundle file \a fileName and reserves \a preallocatedSize bytes
+    of disk space for it, where the platform supports this. The file stays open
+    until remove() is called, or the process dies.
+*/
+bool CrashBundle::create(const std::string &fileName, qint64 preallocatedSize)
+{
+    remove();
+
+    const auto fd = open(fileName.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0600);
+
+    if (fd == -1)
+        return false;
+
+#ifdef Q_OS_UNIX
+    // the lock tells other processes that this file is in use; the kernel drops it when we die
+    flock(fd, LOCK_EX | LOCK_NB);
+#endif
+
+#ifdef Q_OS_LINUX
+    posix_fallocate(fd, 0, static_cast<off_t>(preallocatedSize));
+#else
+    Q_UNUSED(preallocatedSize);
+#endif
+
+    if (write(fd, bundleMagic, sizeof bundleMagic) != sizeof bundleMagic) {
+        close(fd);
+        unlink(fileName.c_str());
+        return false;
+    }
+
+    m_fileName = fileName;
+    m_fileHandle = fd;
+
+    return true;
+}
+
+/*!
+    Closes and deletes the bundle file.
+*/
+void CrashBundle::remove()
+{
+    if (m_fileHandle == -1)
+        return;
+
+    close(m_fileHandle);
+    unlink(m_fileName.c_str());
+
+    m_fileHandle = -1;
+    m_fileName.clear();
+}
+
+/*!
+    Starts a new section of \a type. The section's data must be written
+    to the current position of the bundle's file descriptor, which
+    handle() returns. Returns the start of the section,
+    which must be passed to endSection(), or -1 on error.
+*/
+qint64 CrashBundle::beginSection(SectionType type) const
+{
+    // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
+
+    char header[sectionHeaderSize] = {};
+    qToLittleEndian<quint32>(type, header);
+
+    const auto start = lseek(m_fileHandle, 0, SEEK_CUR);
+
+    if (start == -1 || write(m_fileHandle, header, sizeof header) != sizeof header)
+        return -1;
+
+    return start;
+}
+
+/*!
+    Finishes the section which began at \a start by storing its size.
+*/
+bool CrashBundle::endSection(qint64 start) const
+{
+    // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
+
+    if (start == -1)
+        return false;
+
+    const auto end = lseek(m_fileHandle, 0, SEEK_CUR);
+
+    if (end == -1)
+        return false;
+
+    char size[4];
+    qToLittleEndian<quint32>(static_cast<quint32>(end - start - sectionHeaderSize), size);
+
+    return lseek(m_fileHandle, static_cast<off_t>(start + 4), SEEK_SET) != -1
+            && write(m_fileHandle, size, sizeof size) == sizeof size
+            && lseek(m_fileHandle, end, SEEK_SET) == end;
+}
+
+/*!
+    Reads the list of sections from the bundle file \a fileName.
+    Returns an empty list if the file doesn't exist or is invalid.
+*/
+QVector<CrashBundle::Section> CrashBundle::readSections(const QString &fileName)
+{
+    QFile file{fileName};
+    QVector<Section> sections;
+
+    if (!file.open(QFile::ReadOnly) || file.read(sizeof bundleMagic) != QByteArray::fromRawData(bundleMagic, sizeof bundleMagic))
+        return sections;
+
+    for (;;) {
+        const auto header = file.read(sectionHeaderSize);
+
+        if (header.size() != sectionHeaderSize)
+            break;
+
+        Section section;
+        section.type = static_cast<SectionType>(qFromLittleEndian<quint32>(header.constData()));
+        section.size = qFromLittleEndian<quint32>(header.constData() + 4);
+        section.offset = file.pos();
+
+        if (section.type == EndOfBundle || section.offset + section.size > file.size())
+            break;
+
+        sections.append(section);
+
+        if (!file.seek(section.offset + section.size))
+            break;
+    }
+
+    return sections;
+}
+
+CrashBundleSection::CrashBundleSection(const QString &fileName, const CrashBundle::Section &section, QObject *parent)
+    : QIODevice{parent}
+    , m_file{fileName}
+    , m_section{section}
+{}
+
+bool CrashBundleSection::open(OpenMode mode)
+{
+    if ((mode & ReadWrite) != ReadOnly) {
+        setErrorString(QStringLiteral("Crash bundle sections can only be read"));
+        return false;
+    }
+
+    if (!m_file.open(QFile::ReadOnly)) {
+        setErrorString(m_file.errorString());
+        return false;
+    }
+
+    return QIODevice::open(mode);
+}
+
+void CrashBundleSection::close()
+{
+    m_file.close();
+    QIODevice::close();
+}
+
+qint64 CrashBundleSection::readData(char *data, qint64 maxSize)
+{
+    const auto size = qMin(maxSize, m_section.size - pos());
+
+    if (size <= 0)
+        return size < 0 ? -1 : 0;
+    if (!m_file.seek(m_section.offset + pos()))
+        return -1;
+
+    return m_file.read(data, size);
+}
+
+qint64 CrashBundleSection::writeData(const char *, qint64)
+{
+    return -1;
+}
+
+} // namespace KDHockeyApp
@@ -0,0 +1,105 @@
+//
+// Copyright (C) 2017 Klaralvdalens Datakonsult AB, a KDAB Group company, info@kdab.com.
+// All rights reserved.
+//
+// This file is part of the KD HockeyApp library.
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of either:
+//
+//   The GNU Lesser General Public License version 2.1 and version 3
+//   as published by the Free Software Foundation and appearing in the
+//   file LICENSE.LGPL.txt included.
+//
+// Or:
+//
+//   The Mozilla Public License Version 2.0 as published by the Mozilla
+//   Foundation and appearing in the file LICENSE.MPL2.txt included.
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Contact info@kdab.com if any conditions of this licensing is not clear to you.
+//
+
+
+#ifndef KDHOCKEYAPPCRASHBUNDLE_P_H
+#define KDHOCKEYAPPCRASHBUNDLE_P_H
+
+#include <QFile>
+#include <QVector>
+
+#include <string>
+
+namespace KDHockeyApp {
+
+/**
+ * A single file holding the meta data, log, breadcrumbs and QML stack trace of a crash.
+ *
+ * The file is created and preallocated in advance, and stays open, so that
+ * the crash handler only writes into an existing file descriptor. The file
+ * starts with a magic header, followed by sections consisting of a 32 bit
+ * little endian type, a 32 bit little endian size, and the section's data.
+ * The zeros of the preallocated space end the list of sections.
+ *
+ * The minidump itself still is written by Breakpad into its own file.
+ */
+class CrashBundle
+{
+public:
+    enum SectionType : quint32 { EndOfBundle, MetaData, Log, QmlTrace, Breadcrumbs };
+
+    struct Section
+    {
+        SectionType type = EndOfBundle;
+        qint64 offset = 0;
+        qint64 size = 0;
+    };
+
+    CrashBundle() = default;
+    ~CrashBundle();
+
+    bool create(const std::string &fileName, qint64 preallocatedSize);
+    void remove();
+    bool isOpen() const { return m_fileHandle != -1; }
+    int handle() const { return m_fileHandle; }
+
+    qint64 beginSection(SectionType type) const;
+    bool endSection(qint64 start) const;
+
+    static QVector<Section> readSections(const QString &fileName);
+
+private:
+    Q_DISABLE_COPY(CrashBundle)
+
+    std::string m_fileName;
+    int m_fileHandle = -1;
+};
+
+/**
+ * A read-only device for one section of a crash bundle,
+ * suitable for streaming the section into an upload.
+ */
+class CrashBundleSection : public QIODevice
+{
+public:
+    explicit CrashBundleSection(const QString &fileName, const CrashBundle::Section &section, QObject *parent = {});
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    qint64 size() const override { return m_section.size; }
+
+    QString fileName() const { return m_file.fileName(); }
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 size) override;
+
+private:
+    QFile m_file;
+    const CrashBundle::Section m_section;
+};
+
+} // namespace KDHockeyApp
+
+#endif // KDHOCKEYAPPCRASHBUNDLE_P_H
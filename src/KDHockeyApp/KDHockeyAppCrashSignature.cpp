@@ -0,0 +1,331 @@
+//
+// Copyright (C) 2017 Klaralvdalens Datakonsult AB, a KDAB Group company, info@kdab.com.
+// All rights reserved.
+//
+// This file is part of the KD HockeyApp library.
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of either:
+//
+//   The GNU Lesser General Public License version 2.1 and version 3
+//   as published by the Free Software Foundation and appearing in the
+//   file LICENSE.LGPL.txt included.
+//
+// Or:
+//
+//   The Mozilla Public License Version 2.0 as published by the Mozilla
+//   Foundation and appearing in the file LICENSE.MPL2.txt included.
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Contact info@kdab.com if any conditions of this licensing is not clear to you.
+//
+
+#include "KDHockeyAppCrashSignature_p.h"
+
+#include "KDHockeyAppLiterals_p.h"
+
+#include <google_breakpad/common/minidump_format.h>
+
+#include <QCryptographicHash>
+#include <QFile>
+#include <QFileInfo>
+#include <QSettings>
+#include <QVector>
+
+#include <cstring>
+
+namespace KDHockeyApp {
+
+namespace {
+
+const auto s_indexCount = QStringLiteral("%1/Count");
+const auto s_indexDropped = QStringLiteral("%1/Dropped");
+
+class MiniDumpReader
+{
+public:
+    MiniDumpReader(const uchar *data, qint64 size)
+        : m_data{data}
+        , m_size{static_cast<quint64>(size)}
+    {}
+
+    template<typename T>
+    bool read(quint64 offset, T *value) const
+    {
+        if (offset > m_size || sizeof(T) > m_size - offset)
+            return false;
+
+        memcpy(value, m_data + offset, sizeof(T));
+        return true;
+    }
+
+    bool readPointer(quint64 offset, int pointerSize, quint64 *value) const
+    {
+        if (pointerSize == 4) {
+            quint32 pointer;
+
+            if (!read(offset, &pointer))
+                return false;
+
+            *value = pointer;
+            return true;
+        }
+
+        return read(offset, value);
+    }
+
+    QString readString(quint64 offset) const
+    {
+        quint32 length;
+
+        if (!read(offset, &length) || length > m_size - offset - sizeof length)
+            return {};
+
+        QString text{static_cast<int>(length / 2), Qt::Uninitialized};
+        memcpy(text.data(), m_data + offset + sizeof length, length / 2 * 2);
+        return text;
+    }
+
+private:
+    const uchar *const m_data;
+    const quint64 m_size;
+};
+
+struct Module
+{
+    quint64 base;
+    quint64 size;
+    QString name;
+};
+
+// reads the instruction and stack pointers from the CPU context at offset, and tells the pointer size
+bool readRegisters(const MiniDumpReader &reader, quint32 architecture, quint64 offset,
+                   quint64 *instructionPointer, quint64 *stackPointer, int *pointerSize)
+{
+    switch (architecture) {
+    case MD_CPU_ARCHITECTURE_AMD64: {
+        MDRawContextAMD64 context;
+        *pointerSize = 8;
+
+        if (!reader.read(offset, &context))
+            return false;
+
+        *instructionPointer = context.rip;
+        *stackPointer = context.rsp;
+        return true;
+    }
+
+    case MD_CPU_ARCHITECTURE_X86: {
+        MDRawContextX86 context;
+        *pointerSize = 4;
+
+        if (!reader.read(offset, &context))
+            return false;
+
+        *instructionPointer = context.eip;
+        *stackPointer = context.esp;
+        return true;
+    }
+
+    case MD_CPU_ARCHITECTURE_ARM64: {
+        MDRawContextARM64 context;
+        *pointerSize = 8;
+
+        if (!reader.read(offset, &context))
+            return false;
+
+        *instructionPointer = context.iregs[MD_CONTEXT_ARM64_REG_PC];
+        *stackPointer = context.iregs[MD_CONTEXT_ARM64_REG_SP];
+        return true;
+    }
+
+    case MD_CPU_ARCHITECTURE_ARM: {
+        MDRawContextARM context;
+        *pointerSize = 4;
+
+        if (!reader.read(offset, &context))
+            return false;
+
+        *instructionPointer = context.iregs[MD_CONTEXT_ARM_REG_PC];
+        *stackPointer = context.iregs[MD_CONTEXT_ARM_REG_SP];
+        return true;
+    }
+    }
+
+    return false;
+}
+
+} // namespace
+
+/*!
+    Computes the signature of the crash in the minidump \a fileName from the
+    exception code and up to \a frameCount frames of the crashing thread.
+    Returns an empty array if the minidump cannot be read.
+*/
+QByteArray CrashSignature::fromMiniDump(const QString &fileName, int frameCount)
+{
+    QFile file{fileName};
+
+    if (!file.open(QFile::ReadOnly))
+        return {};
+
+    const auto data = file.map(0, file.size());
+
+    if (!data)
+        return {};
+
+    const MiniDumpReader reader{data, file.size()};
+    MDRawHeader header;
+
+    if (!reader.read(0, &header) || header.signature != MD_HEADER_SIGNATURE)
+        return {};
+
+    MDRawDirectory exceptionStream = {}, threadListStream = {}, moduleListStream = {}, systemInfoStream = {};
+
+    for (quint32 i = 0; i < header.stream_count; ++i) {
+        MDRawDirectory entry;
+
+        if (!reader.read(header.stream_directory_rva + quint64{i} * sizeof entry, &entry))
+            return {};
+
+        switch (entry.stream_type) {
+        case MD_EXCEPTION_STREAM:
+            exceptionStream = entry;
+            break;
+        case MD_THREAD_LIST_STREAM:
+            threadListStream = entry;
+            break;
+        case MD_MODULE_LIST_STREAM:
+            moduleListStream = entry;
+            break;
+        case MD_SYSTEM_INFO_STREAM:
+            systemInfoStream = entry;
+            break;
+        }
+    }
+
+    MDRawExceptionStream exception;
+    MDRawSystemInfo systemInfo;
+    quint32 moduleCount, threadCount;
+
+    if (!exceptionStream.stream_type || !reader.read(exceptionStream.location.rva, &exception)
+            || !systemInfoStream.stream_type || !reader.read(systemInfoStream.location.rva, &systemInfo)
+            || !moduleListStream.stream_type || !reader.read(moduleListStream.location.rva, &moduleCount)
+            || !threadListStream.stream_type || !reader.read(threadListStream.location.rva, &threadCount))
+        return {};
+
+    QVector<Module> modules;
+    modules.reserve(static_cast<int>(qMin(moduleCount, 4096U)));
+
+    for (quint32 i = 0; i < moduleCount; ++i) {
+        MDRawModule module;
+
+        if (!reader.read(moduleListStream.location.rva + sizeof moduleCount + quint64{i} * MD_MODULE_SIZE, &module))
+            break;
+
+        modules.append({module.base_of_image, module.size_of_image,
+                        QFileInfo{reader.readString(module.module_name_rva)}.fileName()});
+    }
+
+    const auto describe = [&modules](quint64 address) -> QByteArray {
+        for (const auto &module: modules) {
+            if (address >= module.base && address - module.base < module.size)
+                return module.name.toUtf8() + '+' + QByteArray::number(address - module.base, 16);
+        }
+
+        return {};
+    };
+
+    quint64 instructionPointer, stackPointer;
+    int pointerSize;
+
+    if (!readRegisters(reader, systemInfo.processor_architecture, exception.thread_context.rva,
+                       &instructionPointer, &stackPointer, &pointerSize))
+        return {};
+
+    QCryptographicHash signature{QCryptographicHash::Sha1};
+    signature.addData(QByteArray::number(exception.exception_record.exception_code, 16));
+    signature.addData("\n" + describe(instructionPointer));
+
+    // find the crashing thread's stack and scan it for return addresses
+    for (quint32 i = 0; i < threadCount; ++i) {
+        MDRawThread thread;
+
+        if (!reader.read(threadListStream.location.rva + sizeof threadCount + quint64{i} * sizeof thread, &thread))
+            break;
+        if (thread.thread_id != exception.thread_id)
+            continue;
+
+        const auto stackStart = thread.stack.start_of_memory_range;
+        const auto stack = thread.stack.memory;
+        auto frames = 1;
+
+        // Breakpad captures the stack from the page below the stack pointer, that area
+        // holds stale data of earlier calls, which would make the signature unstable
+        auto offset = stackPointer > stackStart ? stackPointer - stackStart : 0;
+
+        for (; offset + pointerSize <= stack.data_size && frames < frameCount; offset += pointerSize) {
+            quint64 address;
+
+            if (!reader.readPointer(stack.rva + offset, pointerSize, &address))
+                break;
+
+            const auto frame = describe(address);
+
+            if (!frame.isEmpty()) {
+                signature.addData("\n" + frame);
+                ++frames;
+            }
+        }
+
+        break;
+    }
+
+    return signature.result().toHex();
+}
+
+/*!
+    Creates an index stored in \a fileName.
+*/
+CrashSignatureIndex::CrashSignatureIndex(const QString &fileName)
+    : m_fileName{fileName}
+{}
+
+/*!
+    Records another crash with \a signature. Returns the number of crashes a
+    full report should stand for, or \c 0 if the report should be dropped.
+    Every report is uploaded while the full report limit is zero.
+*/
+int CrashSignatureIndex::record(const QByteArray &signature)
+{
+    const auto fullReportLimit = m_fullReportLimit.load();
+
+    if (fullReportLimit <= 0 || signature.isEmpty())
+        return 1;
+
+    const QMutexLocker lock{&m_mutex};
+    QSettings index{m_fileName, QSettings::IniFormat};
+
+    const auto key = QString::fromLatin1(signature);
+    const auto count = index.value(s_indexCount.arg(key)).toLongLong() + 1;
+    const auto dropped = index.value(s_indexDropped.arg(key)).toInt();
+
+    index.setValue(s_indexCount.arg(key), count);
+
+    if (count > fullReportLimit && !isSampled(count)) {
+        index.setValue(s_indexDropped.arg(key), dropped + 1);
+        return 0;
+    }
+
+    index.remove(s_indexDropped.arg(key));
+    return dropped + 1;
+}
+
+bool CrashSignatureIndex::isSampled(qint64 count)
+{
+    return (count & (count - 1)) == 0;
+}
+
+} // namespace KDHockeyApp
@@ -0,0 +1,81 @@
+//
+// Copyright (C) 2017 Klaralvdalens Datakonsult AB, a KDAB Group company, info@kdab.com.
+// All rights reserved.
+//
+// This file is part of the KD HockeyApp library.
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of either:
+//
+//   The GNU Lesser General Public License version 2.1 and version 3
+//   as published by the Free Software Foundation and appearing in the
+//   file LICENSE.LGPL.txt included.
+//
+// Or:
+//
+//   The Mozilla Public License Version 2.0 as published by the Mozilla
+//   Foundation and appearing in the file LICENSE.MPL2.txt included.
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Contact info@kdab.com if any conditions of this licensing is not clear to you.
+//
+
+#ifndef KDHOCKEYAPPCRASHSIGNATURE_P_H
+#define KDHOCKEYAPPCRASHSIGNATURE_P_H
+
+#include <QByteArray>
+#include <QMutex>
+#include <QString>
+
+#include <atomic>
+
+namespace KDHockeyApp {
+
+/**
+ * Identifies crashes caused by the same bug.
+ *
+ * The signature is a hash of the exception code and the top frames of the crashing
+ * thread, each described as module name plus offset, so that it doesn't depend on
+ * where modules got loaded. Without symbols and unwind information the frames are
+ * found by scanning the thread's stack for addresses within loaded modules, like
+ * Breakpad's stack walker does as last resort. This is good enough for recognizing
+ * repeats of the very same crash, but no replacement for proper symbolication.
+ */
+class CrashSignature
+{
+public:
+    static QByteArray fromMiniDump(const QString &fileName, int frameCount = 8);
+};
+
+/**
+ * Counts how often crashes of each signature have been seen, and decides which of
+ * them get uploaded as full report: The first few reports of each signature, and
+ * after that only reports whose running count is a power of two. The uploaded
+ * reports tell how many of their repeats got dropped in between.
+ *
+ * The index is stored as small ini file next to the crash reports.
+ */
+class CrashSignatureIndex
+{
+public:
+    explicit CrashSignatureIndex(const QString &fileName);
+
+    // NOTICE: The limit is read on worker threads while the application may change it.
+    void setFullReportLimit(int limit) { m_fullReportLimit.store(limit); }
+    int fullReportLimit() const { return m_fullReportLimit.load(); }
+
+    int record(const QByteArray &signature);
+
+private:
+    static bool isSampled(qint64 count);
+
+    const QString m_fileName;
+    QMutex m_mutex;
+    std::atomic<int> m_fullReportLimit{0};
+};
+
+} // namespace KDHockeyApp
+
+#endif // KDHOCKEYAPPCRASHSIGNATURE_P_H
@@ -0,0 +1,290 @@
+//
+// Copyright (C) 2017 Klaralvdalens Datakonsult AB, a KDAB Group company, info@kdab.com.
+// All rights reserved.
+//
+// This file is part of the KD HockeyApp library.
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of either:
+//
+//   The GNU Lesser General Public License version 2.1 and version 3
+//   as published by the Free Software Foundation and appearing in the
+//   file LICENSE.LGPL.txt included.
+//
+// Or:
+//
+//   The Mozilla Public License Version 2.0 as published by the Mozilla
+//   Foundation and appearing in the file LICENSE.MPL2.txt included.
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Contact info@kdab.com if any conditions of this licensing is not clear to you.
+//
+
+#include "KDHockeyAppCrashSpool_p.h"
+
+#include "KDHockeyAppLiterals_p.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLoggingCategory>
+#include <QSet>
+#include <QSettings>
+#include <QtConcurrentRun>
+#include <QVector>
+
+#include <algorithm>
+
+namespace KDHockeyApp {
+
+Q_DECLARE_LOGGING_CATEGORY(lcHockeyApp)
+
+namespace {
+
+const auto s_indexFileName = QStringLiteral("spool.ini");
+const auto s_indexSize = QStringLiteral("%1/Size");
+const auto s_indexLastModified = QStringLiteral("%1/LastModified");
+
+QString crashIdOf(const QString &fileName)
+{
+    return fileName.left(fileName.indexOf('.'_l1));
+}
+
+} // namespace
+
+/*!
+    Creates a spool for the crash directory \a dirPath, and loads its index.
+*/
+CrashSpool::CrashSpool(const QString &dirPath)
+    : m_dirPath{dirPath}
+    , m_indexFileName{QDir{dirPath}.filePath(s_indexFileName)}
+{
+    m_worker.setMaxThreadCount(1);
+    loadIndex();
+}
+
+CrashSpool::~CrashSpool()
+{
+    m_worker.waitForDone();
+}
+
+/*!
+    Limits the crash directory to \a maximumSize bytes and \a maximumCount
+    reports. A limit of zero disables that part of the quota.
+*/
+void CrashSpool::setQuota(qint64 maximumSize, int maximumCount)
+{
+    const QMutexLocker lock{&m_mutex};
+
+    m_maximumSize = qMax<qint64>(0, maximumSize);
+    m_maximumCount = qMax(0, maximumCount);
+
+    updateFullFlag();
+}
+
+/*!
+    Schedules synchronizing the index with the crash directory, and evicting
+    reports if the quota is exceeded.
+*/
+void CrashSpool::scheduleUpdate()
+{
+    QtConcurrent::run(&m_worker, [this] { update(); });
+}
+
+/*!
+    Schedules removing the report \a crashId from the index, after its files
+    got deleted.
+*/
+void CrashSpool::scheduleRemoval(const QString &crashId)
+{
+    QtConcurrent::run(&m_worker, [this, crashId] { remove(crashId); });
+}
+
+/*!
+    Sets the \a handler which gets told about each report that got evicted.
+*/
+void CrashSpool::setEvictionHandler(EvictionHandler handler)
+{
+    const QMutexLocker lock{&m_mutex};
+    m_evictionHandler = std::move(handler);
+}
+
+/*!
+    Protects the report \a crashId from eviction while it is being uploaded.
+*/
+void CrashSpool::beginUpload(const QString &crashId)
+{
+    const QMutexLocker lock{&m_uploadingMutex};
+    m_uploading.insert(crashId);
+}
+
+/*!
+    Allows evicting the report \a crashId again, after its upload finished.
+*/
+void CrashSpool::endUpload(const QString &crashId)
+{
+    const QMutexLocker lock{&m_uploadingMutex};
+    m_uploading.remove(crashId);
+}
+
+void CrashSpool::update()
+{
+    const QMutexLocker lock{&m_mutex};
+
+    synchronize();
+    evict();
+    storeIndex();
+    updateFullFlag();
+}
+
+void CrashSpool::remove(const QString &crashId)
+{
+    const QMutexLocker lock{&m_mutex};
+
+    const auto it = m_reports.find(crashId);
+
+    if (it == m_reports.end())
+        return;
+
+    m_totalSize -= it->size;
+    m_reports.erase(it);
+
+    QSettings{m_indexFileName, QSettings::IniFormat}.remove(crashId);
+    updateFullFlag();
+}
+
+void CrashSpool::loadIndex()
+{
+    QSettings index{m_indexFileName, QSettings::IniFormat};
+
+    for (const auto &crashId: index.childGroups()) {
+        Report report;
+        report.size = index.value(s_indexSize.arg(crashId)).toLongLong();
+        report.lastModified = index.value(s_indexLastModified.arg(crashId)).toLongLong();
+
+        m_reports.insert(crashId, report);
+        m_totalSize += report.size;
+    }
+
+    updateFullFlag();
+}
+
+void CrashSpool::storeIndex() const
+{
+    QSettings index{m_indexFileName, QSettings::IniFormat};
+    index.clear();
+
+    for (auto it = m_reports.cbegin(); it != m_reports.cend(); ++it) {
+        index.setValue(s_indexSize.arg(it.key()), it->size);
+        index.setValue(s_indexLastModified.arg(it.key()), it->lastModified);
+    }
+}
+
+void CrashSpool::synchronize()
+{
+    const QDir dir{m_dirPath};
+
+    // Listing file names is cheap, it's stat'ing them which is not. Therefore
+    // only the files of reports missing in the index get stat'ed.
+    const auto fileNames = dir.entryList(QDir::Files, QDir::Name);
+    QSet<QString> crashIds;
+
+    for (const auto &fileName: fileNames) {
+        if (fileName.endsWith(".dmp"_l1))
+            crashIds.insert(crashIdOf(fileName));
+    }
+
+    for (auto it = m_reports.begin(); it != m_reports.end(); ) {
+        if (!crashIds.contains(it.key())) {
+            m_totalSize -= it->size;
+            it = m_reports.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    QSet<QString> newCrashIds;
+
+    for (const auto &crashId: crashIds) {
+        if (!m_reports.contains(crashId))
+            newCrashIds.insert(crashId);
+    }
+
+    for (const auto &fileName: fileNames) {
+        const auto crashId = crashIdOf(fileName);
+
+        if (!newCrashIds.contains(crashId))
+            continue;
+
+        const QFileInfo fileInfo{dir.filePath(fileName)};
+        auto &report = m_reports[crashId];
+
+        report.size += fileInfo.size();
+        m_totalSize += fileInfo.size();
+
+        if (fileName.endsWith(".dmp"_l1))
+            report.lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+    }
+}
+
+void CrashSpool::evict()
+{
+    if (hasRoomForReport())
+        return;
+
+    QVector<QString> crashIds;
+    crashIds.reserve(m_reports.count());
+
+    for (auto it = m_reports.cbegin(); it != m_reports.cend(); ++it)
+        crashIds.append(it.key());
+
+    std::sort(crashIds.begin(), crashIds.end(), [this](const QString &lhs, const QString &rhs) {
+        return m_reports.value(lhs).lastModified < m_reports.value(rhs).lastModified;
+    });
+
+    const QDir dir{m_dirPath};
+
+    for (const auto &crashId: crashIds) {
+        if (hasRoomForReport())
+            break;
+
+        // its files are open, and the upload queue would report a bogus failure
+        if (isUploading(crashId))
+            continue;
+
+        qCInfo(lcHockeyApp, "Evicting crash report %ls to stay within the quota", qUtf16Printable(crashId));
+
+        for (const auto &fileName: dir.entryList({crashId + ".*"_l1}, QDir::Files))
+            QFile::remove(dir.filePath(fileName));
+
+        m_totalSize -= m_reports.take(crashId).size;
+
+        if (m_evictionHandler)
+            m_evictionHandler(crashId);
+    }
+}
+
+void CrashSpool::updateFullFlag()
+{
+    m_full.store(!hasRoomForReport(), std::memory_order_relaxed);
+}
+
+// tells if another report of average size still fits into the quota
+bool CrashSpool::hasRoomForReport() const
+{
+    const auto averageSize = m_reports.isEmpty() ? 0 : m_totalSize / m_reports.count();
+
+    return (m_maximumSize == 0 || m_totalSize + averageSize <= m_maximumSize)
+            && (m_maximumCount == 0 || m_reports.count() < m_maximumCount);
+}
+
+bool CrashSpool::isUploading(const QString &crashId) const
+{
+    const QMutexLocker lock{&m_uploadingMutex};
+    return m_uploading.contains(crashId);
+}
+
+} // namespace KDHockeyApp
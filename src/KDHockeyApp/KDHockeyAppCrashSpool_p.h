@@ -0,0 +1,117 @@
+//
+// Copyright (C) 2017 Klaralvdalens Datakonsult AB, a KDAB Group company, info@kdab.com.
+// All rights reserved.
+//
+// This file is part of the KD HockeyApp library.
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of either:
+//
+//   The GNU Lesser General Public License version 2.1 and version 3
+//   as published by the Free Software Foundation and appearing in the
+//   file LICENSE.LGPL.txt included.
+//
+// Or:
+//
+//   The Mozilla Public License Version 2.0 as published by the Mozilla
+//   Foundation and appearing in the file LICENSE.MPL2.txt included.
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Contact info@kdab.com if any conditions of this licensing is not clear to you.
+//
+
+#ifndef KDHOCKEYAPPCRASHSPOOL_P_H
+#define KDHOCKEYAPPCRASHSPOOL_P_H
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QSet>
+#include <QThreadPool>
+
+#include <atomic>
+#include <functional>
+
+namespace KDHockeyApp {
+
+/**
+ * Keeps the crash directory within a quota of bytes and reports.
+ *
+ * An index of the reports and their sizes is kept in a small ini file, so that
+ * the directory never needs to be stat'ed as a whole again: Only files of new
+ * reports get stat'ed, and uploaded reports are removed from the index directly.
+ * When there is no room left for another report of average size, the oldest
+ * reports get evicted until there is. Reports which are being uploaded are
+ * skipped, and the eviction handler gets told about each evicted report, so that
+ * the upload queue can forget about it.
+ *
+ * All file system operations happen in order on a dedicated worker thread.
+ *
+ * The crash handler checks isFull() before writing a minidump. The flag gets
+ * computed in advance from the index, therefore crash loops which strike before
+ * the eviction finished cannot grow the directory beyond its quota. The quota only
+ * covers minidumps written by the crash handler itself; crash servers write the
+ * minidumps of their clients elsewhere.
+ */
+class CrashSpool
+{
+public:
+    using EvictionHandler = std::function<void(const QString &crashId)>;
+
+    explicit CrashSpool(const QString &dirPath);
+    ~CrashSpool();
+
+    void setQuota(qint64 maximumSize, int maximumCount);
+    qint64 maximumSize() const { return m_maximumSize; }
+    int maximumCount() const { return m_maximumCount; }
+
+    // NOTICE: This gets called by the crash handler.
+    bool isFull() const { return m_full.load(std::memory_order_relaxed); }
+
+    void scheduleUpdate();
+    void scheduleRemoval(const QString &crashId);
+
+    // NOTICE: The handler gets called on the spool's worker thread.
+    void setEvictionHandler(EvictionHandler handler);
+
+    void beginUpload(const QString &crashId);
+    void endUpload(const QString &crashId);
+
+private:
+    Q_DISABLE_COPY(CrashSpool)
+
+    struct Report
+    {
+        qint64 size = 0;
+        qint64 lastModified = 0;
+    };
+
+    void update();
+    void remove(const QString &crashId);
+    void loadIndex();
+    void storeIndex() const;
+    void synchronize();
+    void evict();
+    void updateFullFlag();
+    bool hasRoomForReport() const;
+    bool isUploading(const QString &crashId) const;
+
+    const QString m_dirPath;
+    const QString m_indexFileName;
+    QThreadPool m_worker;
+    mutable QMutex m_mutex;
+    QHash<QString, Report> m_reports;
+    EvictionHandler m_evictionHandler;
+    mutable QMutex m_uploadingMutex;
+    QSet<QString> m_uploading;
+    qint64 m_totalSize = 0;
+    qint64 m_maximumSize = 0;
+    int m_maximumCount = 0;
+    std::atomic<bool> m_full{false};
+};
+
+} // namespace KDHockeyApp
+
+#endif // KDHOCKEYAPPCRASHSPOOL_P_H
@@ -0,0 +1,177 @@
+//
+// Copyright (C) 2017 Klaralvdalens Datakonsult AB, a KDAB Group company, info@kdab.com.
+// All rights reserved.
+//
+// This file is part of the KD HockeyApp library.
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of either:
+//
+//   The GNU Lesser General Public License version 2.1 and version 3
+//   as published by the Free Software Foundation and appearing in the
+//   file LICENSE.LGPL.txt included.
+//
+// Or:
+//
+//   The Mozilla Public License Version 2.0 as published by the Mozilla
+//   Foundation and appearing in the file LICENSE.MPL2.txt included.
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Contact info@kdab.com if any conditions of this licensing is not clear to you.
+//
+
+
+#include "KDHockeyAppGzipDevice_p.h"
+
+#include <zlib.h>
+
+namespace KDHockeyApp {
+
+namespace {
+
+constexpr int chunkSize = 16384;
+constexpr int gzipWindowBits = 15 + 16; // the largest window, with gzip header and trailer
+
+} // namespace
+
+GzipDevice::GzipDevice(QIODevice *target, int level, QObject *parent)
+    : QIODevice{parent}
+    , m_target{target}
+    , m_level{level}
+{}
+
+GzipDevice::~GzipDevice()
+{
+    close();
+}
+
+bool GzipDevice::open(OpenMode mode)
+{
+    if ((mode & ReadWrite) != WriteOnly) {
+        setErrorString(QStringLiteral("Compressed streams can only be written"));
+        return false;
+    }
+
+    if (!m_target->isWritable()) {
+        setErrorString(QStringLiteral("The target device is not writable"));
+        return false;
+    }
+
+    m_stream.reset(new z_stream{});
+
+    if (deflateInit2(m_stream.get(), m_level, Z_DEFLATED, gzipWindowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        setErrorString(QString::fromLatin1(m_stream->msg ? m_stream->msg : "Could not initialize zlib"));
+        m_stream.reset();
+        return false;
+    }
+
+    return QIODevice::open(mode);
+}
+
+void GzipDevice::close()
+{
+    if (isOpen()) {
+        finish();
+        QIODevice::close();
+    }
+}
+
+/*!
+    Flushes all pending data and writes the gzip trailer. No more
+    data can be written afterwards. Returns \c false on errors.
+*/
+bool GzipDevice::finish()
+{
+    if (!m_stream)
+        return false;
+
+    const auto succeeded = deflateChunk(nullptr, 0, Z_FINISH);
+
+    deflateEnd(m_stream.get());
+    m_stream.reset();
+
+    return succeeded;
+}
+
+/*!
+    Compresses everything that can be read from \a source into \a target,
+    using a fixed size buffer. Returns \c false on errors.
+*/
+bool GzipDevice::compress(QIODevice *source, QIODevice *target, int level)
+{
+    GzipDevice gzip{target, level};
+
+    if (!gzip.open(WriteOnly))
+        return false;
+
+    char buffer[chunkSize];
+
+    for (;;) {
+        const auto size = source->read(buffer, sizeof buffer);
+
+        if (size < 0)
+            return false;
+        if (size == 0)
+            break;
+        if (gzip.write(buffer, size) != size)
+            return false;
+    }
+
+    return gzip.finish();
+}
+
+qint64 GzipDevice::readData(char *, qint64)
+{
+    return -1;
+}
+
+qint64 GzipDevice::writeData(const char *data, qint64 size)
+{
+    if (!m_stream)
+        return -1;
+
+    for (auto remaining = size; remaining > 0; ) {
+        const auto chunk = static_cast<uint>(qMin<qint64>(remaining, chunkSize));
+
+        if (!deflateChunk(data, chunk, Z_NO_FLUSH))
+            return -1;
+
+        data += chunk;
+        remaining -= chunk;
+    }
+
+    return size;
+}
+
+bool GzipDevice::deflateChunk(const char *data, uint size, int flush)
+{
+    char buffer[chunkSize];
+
+    m_stream->next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+    m_stream->avail_in = size;
+
+    do {
+        m_stream->next_out = reinterpret_cast<Bytef *>(buffer);
+        m_stream->avail_out = sizeof buffer;
+
+        const auto status = deflate(m_stream.get(), flush);
+
+        if (status == Z_STREAM_ERROR) {
+            setErrorString(QStringLiteral("Could not compress data"));
+            return false;
+        }
+
+        const auto produced = static_cast<qint64>(sizeof buffer - m_stream->avail_out);
+
+        if (m_target->write(buffer, produced) != produced) {
+            setErrorString(m_target->errorString());
+            return false;
+        }
+    } while (m_stream->avail_out == 0);
+
+    return true;
+}
+
+} // namespace KDHockeyApp
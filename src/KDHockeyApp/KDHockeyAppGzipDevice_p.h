@@ -0,0 +1,73 @@
+//
+// Copyright (C) 2017 Klaralvdalens Datakonsult AB, a KDAB Group company, info@kdab.com.
+// All rights reserved.
+//
+// This file is part of the KD HockeyApp library.
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of either:
+//
+//   The GNU Lesser General Public License version 2.1 and version 3
+//   as published by the Free Software Foundation and appearing in the
+//   file LICENSE.LGPL.txt included.
+//
+// Or:
+//
+//   The Mozilla Public License Version 2.0 as published by the Mozilla
+//   Foundation and appearing in the file LICENSE.MPL2.txt included.
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Contact info@kdab.com if any conditions of this licensing is not clear to you.
+//
+
+
+#ifndef KDHOCKEYAPPGZIPDEVICE_P_H
+#define KDHOCKEYAPPGZIPDEVICE_P_H
+
+#include <QIODevice>
+
+#include <memory>
+
+struct z_stream_s;
+
+namespace KDHockeyApp {
+
+/**
+ * A write-only device that gzip compresses everything written to it into
+ * another device. Data is deflated in small chunks as it arrives, so that
+ * memory usage doesn't depend on the amount of data. The gzip stream is
+ * completed by finish(), which also gets called by close().
+ */
+class GzipDevice : public QIODevice
+{
+public:
+    explicit GzipDevice(QIODevice *target, int level = -1, QObject *parent = {});
+    ~GzipDevice() override;
+
+    bool open(OpenMode mode) override;
+    void close() override;
+    bool isSequential() const override { return true; }
+
+    bool finish();
+
+    static bool compress(QIODevice *source, QIODevice *target, int level = -1);
+
+protected:
+    qint64 readData(char *data, qint64 maxSize) override;
+    qint64 writeData(const char *data, qint64 size) override;
+
+private:
+    Q_DISABLE_COPY(GzipDevice)
+
+    bool deflateChunk(const char *data, uint size, int flush);
+
+    QIODevice *const m_target;
+    const int m_level;
+    std::unique_ptr<z_stream_s> m_stream;
+};
+
+} // namespace KDHockeyApp
+
+#endif // KDHOCKEYAPPGZIPDEVICE_P_H
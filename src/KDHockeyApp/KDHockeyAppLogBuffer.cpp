@@ -0,0 +1,512 @@
+//
+// Copyright (C) 2017 Klaralvdalens Datakonsult AB, a KDAB Group company, info@kdab.com.
+// All rights reserved.
+//
+// This file is part of the KD HockeyApp library.
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of either:
+//
+//   The GNU Lesser General Public License version 2.1 and version 3
+//   as published by the Free Software Foundation and appearing in the
+//   file LICENSE.LGPL.txt included.
+//
+// Or:
+//
+//   The Mozilla Public License Version 2.0 as published by the Mozilla
+//   Foundation and appearing in the file LICENSE.MPL2.txt included.
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Contact info@kdab.com if any conditions of this licensing is not clear to you.
+//
+
+
+#include "KDHockeyAppLogBuffer_p.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <thread>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+#ifdef Q_CC_MSVC
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#ifdef Q_OS_UNIX
+#include <sys/file.h>
+#include <sys/mman.h>
+#endif
+
+namespace KDHockeyApp {
+
+struct LogBuffer::Header
+{
+    enum Flag : quint32 { Binary = 1 };
+
+    char magic[8];
+    quint32 version;
+    quint32 flags;
+    quint64 capacity;
+    std::atomic<quint64> head;
+};
+
+namespace {
+
+constexpr char s_magic[8] = {'K', 'D', 'H', 'A', 'L', 'O', 'G', '\0'};
+constexpr quint32 s_version = 1;
+constexpr int s_lockDownAttempts = 10000;
+
+quint64 ringCapacity(int requested)
+{
+    if (requested <= 0)
+        return 0;
+
+    quint64 capacity = 1;
+
+    while (capacity < static_cast<quint64>(requested))
+        capacity <<= 1;
+
+    return capacity;
+}
+
+bool writeFully(int fd, const char *data, quint64 size)
+{
+    while (size > 0) {
+        const auto written = write(fd, data, static_cast<unsigned>(size));
+
+        if (written <= 0)
+            return false;
+
+        data += written;
+        size -= static_cast<quint64>(written);
+    }
+
+    return true;
+}
+
+bool writeRing(int fd, const char *data, quint64 capacity, quint64 head, bool binary)
+{
+    // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
+
+    auto size = std::min(head, capacity);
+    auto begin = capacity > 0 ? (head - size) & (capacity - 1) : 0;
+
+    if (binary) {
+        const char sizePrefix[4] = {
+            static_cast<char>(size), static_cast<char>(size >> 8),
+            static_cast<char>(size >> 16), static_cast<char>(size >> 24)
+        };
+
+        if (!writeFully(fd, sizePrefix, sizeof sizePrefix))
+            return false;
+    } else if (head > capacity) {
+        // the buffer has wrapped, therefore its first line most probably got truncated
+        for (; size > 0 && data[begin] != '\n'; --size)
+            begin = (begin + 1) & (capacity - 1);
+        for (; size > 0 && data[begin] == '\n'; --size)
+            begin = (begin + 1) & (capacity - 1);
+    }
+
+    const auto chunk = std::min(size, capacity - begin);
+
+    return writeFully(fd, data + begin, chunk)
+            && writeFully(fd, data, size - chunk);
+}
+
+} // namespace
+
+LogBuffer::LogBuffer(int capacity)
+{
+    const auto ringSize = ringCapacity(capacity);
+    replaceStorage(new char[storageSize(ringSize)], ringSize, false);
+}
+
+LogBuffer::~LogBuffer()
+{
+    releaseStorage();
+}
+
+quint64 LogBuffer::storageSize(quint64 capacity)
+{
+    return sizeof(Header) + capacity;
+}
+
+LogBuffer::Header *LogBuffer::initializeStorage(char *storage, quint64 capacity)
+{
+    const auto header = new(storage) Header;
+
+    memcpy(header->magic, s_magic, sizeof s_magic);
+    header->version = s_version;
+    header->flags = 0;
+    header->capacity = capacity;
+    header->head.store(0);
+
+    return header;
+}
+
+qint64 LogBuffer::roundedCapacity(int capacity)
+{
+    return static_cast<qint64>(ringCapacity(capacity));
+}
+
+/*!
+    Moves the ring into \a storage of the given \a capacity, preserving as
+    much of its current contents as fits. This is done while the buffer is
+    locked down, so messages logged during this operation are dropped.
+*/
+bool LogBuffer::replaceStorage(char *storage, quint64 capacity, bool mapped)
+{
+    const auto header = initializeStorage(storage, capacity);
+    const auto data = storage + sizeof(Header);
+
+    if (m_header) {
+        if (!lockDown()) {
+            release();
+            return false;
+        }
+
+        const auto oldCapacity = m_capacity.load();
+        const auto head = m_header->head.load();
+
+        if (capacity == oldCapacity) {
+            memcpy(data, m_data, capacity);
+        } else {
+            // keep the ring's logical offsets, so that writeRing() still finds the first complete line
+            for (auto i = head - std::min({head, capacity, oldCapacity}); i < head; ++i)
+                data[i & (capacity - 1)] = m_data[i & (oldCapacity - 1)];
+        }
+
+        header->head.store(capacity > 0 ? head : 0);
+        header->flags = m_header->flags;
+        releaseStorage();
+    }
+
+    m_storage = storage;
+    m_header = header;
+    m_data = data;
+    m_mapped = mapped;
+    m_capacity.store(capacity);
+
+    release();
+    return true;
+}
+
+void LogBuffer::releaseStorage()
+{
+    if (!m_storage)
+        return;
+
+#ifdef Q_OS_UNIX
+    if (m_mapped) {
+        munmap(m_storage, storageSize(m_capacity.load()));
+        close(m_fileHandle); // also releases the lock
+        m_fileHandle = -1;
+        return;
+    }
+#endif
+
+    delete[] m_storage;
+}
+
+void LogBuffer::append(const char *data, int size)
+{
+    if (size <= 0)
+        return;
+
+    // Announce this writer before checking the lock-down flag. Both operations are
+    // sequentially consistent, so either lockDown() sees this writer, or we see the flag.
+    m_writers.fetch_add(1);
+
+    // the storage only gets replaced while locked down, so it must be read after checking that flag
+    const auto capacity = m_lockedDown.load() ? 0 : m_capacity.load(std::memory_order_relaxed);
+
+    if (capacity > 0) {
+        auto length = static_cast<quint64>(size);
+
+        if (length > capacity) { // only the tail would survive anyway
+            data += length - capacity;
+            length = capacity;
+        }
+
+        const auto offset = m_header->head.fetch_add(length, std::memory_order_relaxed) & (capacity - 1);
+        const auto chunk = std::min(length, capacity - offset);
+
+        memcpy(m_data + offset, data, chunk);
+        memcpy(m_data, data + chunk, length - chunk);
+    }
+
+    m_writers.fetch_sub(1, std::memory_order_release);
+}
+
+/*!
+    Appends \a data only if it fits into the remaining capacity. This allows
+    to use the buffer as an append-only store that never overwrites data.
+*/
+bool LogBuffer::tryAppend(const char *data, int size)
+{
+    auto appended = false;
+
+    m_writers.fetch_add(1);
+
+    if (size > 0 && !m_lockedDown.load()) {
+        const auto capacity = m_capacity.load(std::memory_order_relaxed);
+        const auto length = static_cast<quint64>(size);
+        auto head = m_header->head.load(std::memory_order_relaxed);
+
+        while (head + length <= capacity) {
+            if (m_header->head.compare_exchange_weak(head, head + length, std::memory_order_relaxed)) {
+                memcpy(m_data + head, data, length);
+                appended = true;
+                break;
+            }
+        }
+    }
+
+    m_writers.fetch_sub(1, std::memory_order_release);
+    return appended;
+}
+
+/*!
+    Switches between text and binary mode. As the existing contents would
+    become unreadable, the buffer gets cleared.
+*/
+bool LogBuffer::setBinary(bool binary)
+{
+    if (!lockDown()) {
+        release();
+        return false;
+    }
+
+    if (binary)
+        m_header->flags |= Header::Binary;
+    else
+        m_header->flags &= ~Header::Binary;
+
+    m_header->head.store(0);
+    m_binary.store(binary);
+
+    release();
+    return true;
+}
+
+/*!
+    Stops accepting new writes and waits for pending writers to finish.
+    Returns \c false if some writer didn't finish in time, which happens for
+    instance when the crashing thread itself was in the middle of append().
+*/
+bool LogBuffer::lockDown()
+{
+    // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
+
+    m_lockedDown.store(true);
+
+    for (auto i = 0; i < s_lockDownAttempts; ++i) {
+        if (m_writers.load(std::memory_order_acquire) == 0)
+            return true;
+
+        std::this_thread::yield();
+    }
+
+    return false;
+}
+
+void LogBuffer::release()
+{
+    m_lockedDown.store(false);
+}
+
+/*!
+    Changes the capacity of this buffer. The new capacity gets rounded
+    up to the next power of two. Memory mapped buffers cannot be resized.
+*/
+bool LogBuffer::resize(int capacity)
+{
+    const auto ringSize = ringCapacity(capacity);
+
+    if (ringSize == m_capacity.load())
+        return true;
+    if (m_mapped)
+        return false;
+
+    const auto storage = new char[storageSize(ringSize)];
+
+    if (!replaceStorage(storage, ringSize, false)) {
+        delete[] storage;
+        return false;
+    }
+
+    return true;
+}
+
+int LogBuffer::size() const
+{
+    return static_cast<int>(std::min(m_header->head.load(std::memory_order_acquire), m_capacity.load()));
+}
+
+bool LogBuffer::writeTo(int fd) const
+{
+    // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
+    return writeRing(fd, m_data, m_capacity.load(), m_header->head.load(std::memory_order_acquire), isBinary());
+}
+
+/*!
+    Moves the ring into a shared memory mapping of \a fileName. Returns
+    \c false if the file cannot be mapped, or if memory mapped files are not
+    supported on this platform.
+*/
+bool LogBuffer::mapFile(const char *fileName)
+{
+#ifdef Q_OS_UNIX
+    if (m_mapped)
+        return false;
+
+    const auto fd = open(fileName, O_CREAT | O_RDWR | O_TRUNC, 0600);
+
+    if (fd == -1)
+        return false;
+
+    const auto capacity = m_capacity.load();
+    const auto size = storageSize(capacity);
+    auto storage = MAP_FAILED;
+
+    // the lock tells other processes that this file is in use; the kernel drops it when we die
+    if (flock(fd, LOCK_EX | LOCK_NB) == 0 && ftruncate(fd, static_cast<off_t>(size)) == 0)
+        storage = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+    if (storage == MAP_FAILED) {
+        close(fd);
+        unlink(fileName);
+        return false;
+    }
+
+    const auto fileHandle = m_fileHandle;
+    m_fileHandle = fd;
+
+    if (!replaceStorage(static_cast<char *>(storage), capacity, true)) {
+        m_fileHandle = fileHandle;
+        munmap(storage, size);
+        close(fd);
+        unlink(fileName);
+        return false;
+    }
+
+    return true;
+#else
+    Q_UNUSED(fileName);
+    return false;
+#endif
+}
+
+/*!
+    Moves the ring back into anonymous memory.
+*/
+bool LogBuffer::unmapFile()
+{
+    if (!m_mapped)
+        return false;
+
+    const auto capacity = m_capacity.load();
+    const auto storage = new char[storageSize(capacity)];
+
+    if (!replaceStorage(storage, capacity, false)) {
+        delete[] storage;
+        return false;
+    }
+
+    return true;
+}
+
+/*!
+    Checks if the ring buffer file \a fileName still is mapped by some process.
+*/
+bool LogBuffer::isFileInUse(const char *fileName)
+{
+#ifdef Q_OS_UNIX
+    const auto fd = open(fileName, O_RDONLY);
+
+    if (fd == -1)
+        return false;
+
+    const auto locked = (flock(fd, LOCK_SH | LOCK_NB) != 0);
+    close(fd);
+
+    return locked;
+#else
+    Q_UNUSED(fileName);
+    return false;
+#endif
+}
+
+/*!
+    Checks if the ring buffer file \a fileName holds binary records.
+*/
+bool LogBuffer::isBinaryFile(const char *fileName)
+{
+    const auto fd = open(fileName, O_RDONLY);
+
+    if (fd == -1)
+        return false;
+
+    Header header;
+    const auto binary = read(fd, &header, sizeof header) == sizeof header
+            && memcmp(header.magic, s_magic, sizeof s_magic) == 0
+            && (header.flags & Header::Binary);
+
+    close(fd);
+    return binary;
+}
+
+/*!
+    Writes the contents of a ring buffer file created by mapFile() to \a fd.
+    This works no matter if the process owning that file has crashed,
+    quit cleanly, or has been killed.
+*/
+bool LogBuffer::recoverFile(const char *fileName, int fd)
+{
+#ifdef Q_OS_UNIX
+    const auto input = open(fileName, O_RDONLY);
+
+    if (input == -1)
+        return false;
+
+    struct stat fileInfo;
+    auto storage = MAP_FAILED;
+
+    if (fstat(input, &fileInfo) == 0 && static_cast<quint64>(fileInfo.st_size) > sizeof(Header))
+        storage = mmap(nullptr, static_cast<size_t>(fileInfo.st_size), PROT_READ, MAP_PRIVATE, input, 0);
+
+    close(input);
+
+    if (storage == MAP_FAILED)
+        return false;
+
+    const auto header = static_cast<const Header *>(storage);
+    const auto capacity = header->capacity;
+    auto succeeded = false;
+
+    if (memcmp(header->magic, s_magic, sizeof s_magic) == 0
+            && header->version == s_version
+            && (capacity & (capacity - 1)) == 0
+            && storageSize(capacity) == static_cast<quint64>(fileInfo.st_size)) {
+        const auto data = static_cast<const char *>(storage) + sizeof(Header);
+        succeeded = writeRing(fd, data, capacity, header->head.load(), header->flags & Header::Binary);
+    }
+
+    munmap(storage, static_cast<size_t>(fileInfo.st_size));
+    return succeeded;
+#else
+    Q_UNUSED(fileName);
+    Q_UNUSED(fd);
+    return false;
+#endif
+}
+
+} // namespace KDHockeyApp
@@ -0,0 +1,121 @@
+//
+// Copyright (C) 2017 Klaralvdalens Datakonsult AB, a KDAB Group company, info@kdab.com.
+// All rights reserved.
+//
+// This file is part of the KD HockeyApp library.
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of either:
+//
+//   The GNU Lesser General Public License version 2.1 and version 3
+//   as published by the Free Software Foundation and appearing in the
+//   file LICENSE.LGPL.txt included.
+//
+// Or:
+//
+//   The Mozilla Public License Version 2.0 as published by the Mozilla
+//   Foundation and appearing in the file LICENSE.MPL2.txt included.
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Contact info@kdab.com if any conditions of this licensing is not clear to you.
+//
+
+
+#ifndef KDHOCKEYAPPLOGBUFFER_P_H
+#define KDHOCKEYAPPLOGBUFFER_P_H
+
+#include <QtGlobal>
+
+#include <atomic>
+
+namespace KDHockeyApp {
+
+/**
+ * A multi-producer, lock-free byte ring buffer for the crash log.
+ *
+ * Writers reserve space for an entire record with a single atomic increment
+ * and then copy it using at most two memcpy() calls. The storage is allocated
+ * up front by the constructor or resize(), so neither appending nor dumping
+ * allocates memory. A buffer with zero capacity drops all writes.
+ *
+ * Records are not protected against being overwritten while still being
+ * copied, which only happens if the ring wraps within that time. The
+ * capacity should comfortably exceed the amount of data logged concurrently.
+ *
+ * Writers share the writer count and the head offset, but don't stage their
+ * records in per-thread buffers: Staged records would be invisible to the
+ * crash handler, which only can dump this ring, and they would reach it out
+ * of order. The two atomic increments per record are cheap compared to
+ * formatting the message.
+ *
+ * To take a crash-safe snapshot the buffer is locked down: new writes are
+ * dropped and writers still copying data get a short grace period. After that
+ * writeTo() dumps the ring directly from its storage.
+ *
+ * On Unix the storage can be moved into a shared file mapping by mapFile().
+ * The header with the ring's head offset lives in the same mapping, so the
+ * kernel persists a consistent log even if the process dies without running
+ * any crash handler. Such files get converted by recoverFile().
+ *
+ * Binary buffers hold records that cannot be split at line breaks. They are
+ * dumped as they are, prefixed by their size as 32 bit little endian number.
+ */
+class LogBuffer
+{
+public:
+    explicit LogBuffer(int capacity = 0);
+    ~LogBuffer();
+
+    bool resize(int capacity);
+
+    void append(const char *data, int size);
+    bool tryAppend(const char *data, int size);
+
+    bool setBinary(bool binary);
+    bool isBinary() const { return m_binary.load(std::memory_order_relaxed); }
+
+    bool lockDown();
+    void release();
+
+    bool writeTo(int fd) const;
+
+    bool mapFile(const char *fileName);
+    bool unmapFile();
+    bool isMapped() const { return m_mapped; }
+
+    static bool isFileInUse(const char *fileName);
+    static bool isBinaryFile(const char *fileName);
+    static bool recoverFile(const char *fileName, int fd);
+
+    int capacity() const { return static_cast<int>(m_capacity.load(std::memory_order_relaxed)); }
+    int size() const;
+
+    static qint64 roundedCapacity(int capacity);
+
+private:
+    Q_DISABLE_COPY(LogBuffer)
+
+    struct Header;
+
+    static quint64 storageSize(quint64 capacity);
+    static Header *initializeStorage(char *storage, quint64 capacity);
+    bool replaceStorage(char *storage, quint64 capacity, bool mapped);
+    void releaseStorage();
+
+    std::atomic<quint64> m_capacity{0};
+    char *m_storage = nullptr;
+    Header *m_header = nullptr;
+    char *m_data = nullptr;
+    bool m_mapped = false;
+    int m_fileHandle = -1;
+
+    std::atomic<int> m_writers{0};
+    std::atomic<bool> m_lockedDown{false};
+    std::atomic<bool> m_binary{false};
+};
+
+} // namespace KDHockeyApp
+
+#endif // KDHOCKEYAPPLOGBUFFER_P_H
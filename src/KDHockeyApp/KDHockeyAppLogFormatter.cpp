@@ -0,0 +1,349 @@
+//
+// Copyright (C) 2017 Klaralvdalens Datakonsult AB, a KDAB Group company, info@kdab.com.
+// All rights reserved.
+//
+// This file is part of the KD HockeyApp library.
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of either:
+//
+//   The GNU Lesser General Public License version 2.1 and version 3
+//   as published by the Free Software Foundation and appearing in the
+//   file LICENSE.LGPL.txt included.
+//
+// Or:
+//
+//   The Mozilla Public License Version 2.0 as published by the Mozilla
+//   Foundation and appearing in the file LICENSE.MPL2.txt included.
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Contact info@kdab.com if any conditions of this licensing is not clear to you.
+//
+
+
+#include "KDHockeyAppLogFormatter_p.h"
+
+#include "KDHockeyAppLogBuffer_p.h"
+
+#include <QString>
+
+#include <cstring>
+
+namespace KDHockeyApp {
+
+namespace {
+
+const char *typePrefix(QtMsgType type)
+{
+    switch (type) {
+    case QtDebugMsg:
+        return "[D] ";
+    case QtWarningMsg:
+        return "[W] ";
+    case QtCriticalMsg:
+        return "[C] ";
+    case QtFatalMsg:
+        return "[F] ";
+    case QtInfoMsg:
+        return "[I] ";
+    }
+
+    return "[?] ";
+}
+
+bool isHighSurrogate(uint ch) { return (ch & 0xfc00) == 0xd800; }
+bool isLowSurrogate(uint ch) { return (ch & 0xfc00) == 0xdc00; }
+
+constexpr int s_maximumInternedLength = 1024;
+constexpr int s_maximumInlineLength = 255;
+constexpr int s_recordTrailerSize = 2;
+
+quint64 hashString(const char *str, int length)
+{
+    quint64 hash = 14695981039346656037ull; // FNV-1a
+
+    for (auto i = 0; i < length; ++i) {
+        hash ^= static_cast<uchar>(str[i]);
+        hash *= 1099511628211ull;
+    }
+
+    return hash | 1; // zero marks empty slots
+}
+
+} // namespace
+
+quint32 LogStringTable::intern(const char *str)
+{
+    const auto length = static_cast<int>(strlen(str));
+
+    if (length > s_maximumInternedLength)
+        return 0;
+
+    const auto hash = hashString(str, length);
+
+    for (auto probe = 0; probe < s_maximumProbes; ++probe) {
+        auto &slot = m_slots[(hash + static_cast<quint64>(probe)) % s_slotCount];
+        auto slotHash = slot.hash.load(std::memory_order_acquire);
+
+        if (slotHash == 0 && slot.hash.compare_exchange_strong(slotHash, hash)) {
+            // we own this slot now, publish the string's definition
+            const auto id = m_nextId.fetch_add(1, std::memory_order_relaxed);
+
+            char buffer[s_maximumInternedLength + 16];
+            LogFormatter definition{buffer};
+            definition.appendVarint(id).appendVarint(static_cast<quint64>(length)).append(str, length);
+
+            if (!m_definitions->tryAppend(definition.data(), definition.size()))
+                return 0; // the slot stays without id, so this string always gets stored inline
+
+            slot.id.store(id, std::memory_order_release);
+            return id;
+        }
+
+        if (slotHash == hash)
+            return slot.id.load(std::memory_order_acquire); // zero while still being published
+    }
+
+    return 0;
+}
+
+bool LogFormatter::reserve(int length)
+{
+    if (m_truncated || m_size + length > m_capacity) {
+        m_truncated = true;
+        return false;
+    }
+
+    return true;
+}
+
+LogFormatter &LogFormatter::append(char ch)
+{
+    if (reserve(1))
+        m_buffer[m_size++] = ch;
+
+    return *this;
+}
+
+LogFormatter &LogFormatter::append(const char *str)
+{
+    return append(str, static_cast<int>(strlen(str)));
+}
+
+LogFormatter &LogFormatter::append(const char *str, int length)
+{
+    if (m_truncated)
+        return *this;
+
+    if (m_size + length > m_capacity) {
+        length = m_capacity - m_size;
+        m_truncated = true;
+    }
+
+    memcpy(m_buffer + m_size, str, static_cast<size_t>(length));
+    m_size += length;
+
+    return *this;
+}
+
+LogFormatter &LogFormatter::append(int number)
+{
+    char digits[12];
+    auto cursor = digits + sizeof digits;
+    auto value = number < 0 ? 0u - static_cast<uint>(number) : static_cast<uint>(number);
+
+    do {
+        *--cursor = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+
+    if (number < 0)
+        *--cursor = '-';
+
+    return append(cursor, static_cast<int>(digits + sizeof digits - cursor));
+}
+
+LogFormatter &LogFormatter::append(const QString &text)
+{
+    const auto utf16 = text.utf16();
+    const auto length = text.size();
+
+    for (auto i = 0; i < length && !m_truncated; ++i) {
+        uint ch = utf16[i];
+
+        if (isHighSurrogate(ch) && i + 1 < length && isLowSurrogate(utf16[i + 1]))
+            ch = 0x10000 + ((ch - 0xd800) << 10) + (utf16[++i] - 0xdc00);
+        else if (isHighSurrogate(ch) || isLowSurrogate(ch))
+            ch = 0xfffd; // unpaired surrogate, use the replacement character
+
+        // encode the entire code point, or nothing at all
+        if (ch < 0x80) {
+            if (reserve(1))
+                m_buffer[m_size++] = static_cast<char>(ch);
+        } else if (ch < 0x800) {
+            if (reserve(2)) {
+                m_buffer[m_size++] = static_cast<char>(0xc0 | (ch >> 6));
+                m_buffer[m_size++] = static_cast<char>(0x80 | (ch & 0x3f));
+            }
+        } else if (ch < 0x10000) {
+            if (reserve(3)) {
+                m_buffer[m_size++] = static_cast<char>(0xe0 | (ch >> 12));
+                m_buffer[m_size++] = static_cast<char>(0x80 | ((ch >> 6) & 0x3f));
+                m_buffer[m_size++] = static_cast<char>(0x80 | (ch & 0x3f));
+            }
+        } else {
+            if (reserve(4)) {
+                m_buffer[m_size++] = static_cast<char>(0xf0 | (ch >> 18));
+                m_buffer[m_size++] = static_cast<char>(0x80 | ((ch >> 12) & 0x3f));
+                m_buffer[m_size++] = static_cast<char>(0x80 | ((ch >> 6) & 0x3f));
+                m_buffer[m_size++] = static_cast<char>(0x80 | (ch & 0x3f));
+            }
+        }
+    }
+
+    return *this;
+}
+
+LogFormatter &LogFormatter::appendVarint(quint64 value)
+{
+    char bytes[10];
+    auto length = 0;
+
+    do {
+        bytes[length] = static_cast<char>(value & 0x7f);
+        value >>= 7;
+
+        if (value)
+            bytes[length] |= static_cast<char>(0x80);
+
+        ++length;
+    } while (value);
+
+    if (reserve(length)) {
+        memcpy(m_buffer + m_size, bytes, static_cast<size_t>(length));
+        m_size += length;
+    }
+
+    return *this;
+}
+
+LogFormatter &LogFormatter::appendStringReference(const char *str, LogStringTable *strings)
+{
+    if (!str)
+        return appendVarint(0);
+
+    if (const auto id = strings->intern(str))
+        return appendVarint(static_cast<quint64>(id) << 1);
+
+    const auto length = qMin(static_cast<int>(strlen(str)), s_maximumInlineLength);
+    return appendVarint((static_cast<quint64>(length) << 1) | 1).append(str, length);
+}
+
+/*!
+    Formats a compact binary record:
+
+    \list
+    \li the \a timestamp as varint
+    \li the message type as single byte
+    \li category and function as varint string references
+    \li the line number as varint
+    \li the UTF-8 encoded message
+    \li the size of all the above as 16 bit little endian number
+    \endlist
+
+    String references are either zero for null strings, an interned string
+    id shifted left by one bit, or for inline strings, their length shifted
+    left by one bit with the lowest bit set, followed by the string's bytes.
+
+    The size comes last, so that a ring buffer of such records can be parsed
+    backwards starting from its most recent record.
+*/
+LogFormatter &LogFormatter::appendBinaryRecord(QtMsgType type, const QMessageLogContext &context,
+                                               const QString &message, quint64 timestamp,
+                                               LogStringTable *strings)
+{
+    const auto start = m_size;
+
+    m_capacity -= s_recordTrailerSize;
+
+    appendVarint(timestamp);
+    append(static_cast<char>(type));
+    appendStringReference(context.category, strings);
+    appendStringReference(context.function, strings);
+    appendVarint(static_cast<quint64>(qMax(context.line, 0)));
+    append(message);
+
+    m_capacity += s_recordTrailerSize;
+
+    const auto size = m_size - start;
+    m_buffer[m_size++] = static_cast<char>(size & 0xff);
+    m_buffer[m_size++] = static_cast<char>(size >> 8);
+
+    return *this;
+}
+
+/*!
+    Formats a record the same way the message handler always did:
+
+        [W] category: function, line 42: message
+*/
+LogFormatter &LogFormatter::appendTextRecord(QtMsgType type, const QMessageLogContext &context, const QString &message)
+{
+    append(typePrefix(type));
+
+    if (context.category)
+        append(context.category).append(": ");
+
+    if (context.function) {
+        append(context.function);
+
+        if (context.line > 0)
+            append(", line ").append(context.line);
+
+        append(": ");
+    }
+
+    append(message);
+    finishLine();
+
+    return *this;
+}
+
+/*!
+    Terminates the current record with a newline. For truncated records
+    the last few bytes get replaced by an ellipsis to make the truncation
+    visible, also it is ensured that no partial UTF-8 sequence remains.
+*/
+void LogFormatter::finishLine()
+{
+    static constexpr char ellipsis[] = "...\n";
+    static constexpr int ellipsisLength = sizeof ellipsis - 1;
+
+    if (!m_truncated && m_size < m_capacity) {
+        m_buffer[m_size++] = '\n';
+        return;
+    }
+
+    m_size = qMax(0, qMin(m_size, m_capacity - ellipsisLength));
+
+    // drop the last UTF-8 sequence if it got cut
+    auto start = m_size;
+    while (start > 0 && (m_buffer[start - 1] & 0xc0) == 0x80)
+        --start;
+
+    if (start > 0 && (m_buffer[start - 1] & 0x80)) {
+        const auto lead = static_cast<uchar>(m_buffer[start - 1]);
+        const auto expected = lead >= 0xf0 ? 4 : lead >= 0xe0 ? 3 : 2;
+
+        if (m_size - start + 1 < expected)
+            m_size = start - 1;
+    }
+
+    const auto length = qMin(ellipsisLength, m_capacity - m_size);
+    memcpy(m_buffer + m_size, ellipsis + ellipsisLength - length, static_cast<size_t>(length));
+    m_size += length;
+}
+
+} // namespace KDHockeyApp
@@ -0,0 +1,126 @@
+//
+// Copyright (C) 2017 Klaralvdalens Datakonsult AB, a KDAB Group company, info@kdab.com.
+// All rights reserved.
+//
+// This file is part of the KD HockeyApp library.
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of either:
+//
+//   The GNU Lesser General Public License version 2.1 and version 3
+//   as published by the Free Software Foundation and appearing in the
+//   file LICENSE.LGPL.txt included.
+//
+// Or:
+//
+//   The Mozilla Public License Version 2.0 as published by the Mozilla
+//   Foundation and appearing in the file LICENSE.MPL2.txt included.
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Contact info@kdab.com if any conditions of this licensing is not clear to you.
+//
+
+
+#ifndef KDHOCKEYAPPLOGFORMATTER_P_H
+#define KDHOCKEYAPPLOGFORMATTER_P_H
+
+#include <QtGlobal>
+
+#include <atomic>
+
+QT_BEGIN_NAMESPACE
+class QMessageLogContext;
+class QString;
+QT_END_NAMESPACE
+
+namespace KDHockeyApp {
+
+class LogBuffer;
+
+/**
+ * Interns category and function names for binary log records.
+ *
+ * Each new string gets a small numeric id and is stored once as definition
+ * record in an append-only LogBuffer: the varint encoded id and length,
+ * followed by the string's bytes. Known strings are looked up by their hash
+ * without taking locks. When the table or the definition buffer is full,
+ * intern() returns zero and the caller should store the string inline.
+ */
+class LogStringTable
+{
+public:
+    explicit LogStringTable(LogBuffer *definitions)
+        : m_definitions{definitions}
+    {}
+
+    quint32 intern(const char *str);
+
+private:
+    Q_DISABLE_COPY(LogStringTable)
+
+    struct Slot
+    {
+        std::atomic<quint64> hash{0};
+        std::atomic<quint32> id{0};
+    };
+
+    static constexpr int s_slotCount = 1024;
+    static constexpr int s_maximumProbes = 16;
+
+    Slot m_slots[s_slotCount];
+    std::atomic<quint32> m_nextId{1};
+    LogBuffer *const m_definitions;
+};
+
+/**
+ * Formats log records into a fixed, caller provided buffer.
+ *
+ * Unlike QString concatenation the formatter never allocates memory:
+ * strings are copied as they are, numbers are converted digit by digit
+ * and QString is encoded to UTF-8 on the fly. Records that don't fit are
+ * truncated at a character boundary.
+ */
+class LogFormatter
+{
+public:
+    explicit LogFormatter(char *buffer, int capacity)
+        : m_buffer{buffer}
+        , m_capacity{capacity}
+    {}
+
+    template<int N>
+    explicit LogFormatter(char (&buffer)[N])
+        : LogFormatter{buffer, N}
+    {}
+
+    LogFormatter &append(char ch);
+    LogFormatter &append(const char *str);
+    LogFormatter &append(const char *str, int length);
+    LogFormatter &append(int number);
+    LogFormatter &append(const QString &text);
+    LogFormatter &appendVarint(quint64 value);
+
+    LogFormatter &appendTextRecord(QtMsgType type, const QMessageLogContext &context, const QString &message);
+    LogFormatter &appendBinaryRecord(QtMsgType type, const QMessageLogContext &context, const QString &message,
+                                     quint64 timestamp, LogStringTable *strings);
+    void finishLine();
+
+    const char *data() const { return m_buffer; }
+    int size() const { return m_size; }
+    bool isTruncated() const { return m_truncated; }
+
+private:
+    bool reserve(int length);
+    LogFormatter &appendStringReference(const char *str, LogStringTable *strings);
+
+    char *const m_buffer;
+    int m_capacity;
+    int m_size = 0;
+    bool m_truncated = false;
+};
+
+} // namespace KDHockeyApp
+
+#endif // KDHOCKEYAPPLOGFORMATTER_P_H
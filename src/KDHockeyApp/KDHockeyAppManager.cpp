@@ -26,26 +26,34 @@
 
 #include "KDHockeyAppConfig.h"
 #include "KDHockeyAppLiterals_p.h"
+#include "KDHockeyAppLogBuffer_p.h"
+#include "KDHockeyAppLogFormatter_p.h"
+#include "KDHockeyAppSoftAssert_p.h"
 
-#ifdef KDHOCKEYAPP_QMLSUPPORT_ENABLED
-#include <private/qqmlengine_p.h>
+#ifdef KDHOCKEYAPP_COMPRESSION_ENABLED
+#include "KDHockeyAppGzipDevice_p.h"
 #endif
 
 #include <QCoreApplication>
 #include <QDateTime>
 #include <QDirIterator>
+#include <QElapsedTimer>
 #include <QFile>
+#include <QFileInfo>
 #include <QHttpMultiPart>
-#include <QJsonArray>
-#include <QJsonDocument>
-#include <QJsonObject>
 #include <QLoggingCategory>
+#include <QMutex>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QSettings>
+#include <QTemporaryFile>
+#include <QTimer>
+#include <QtConcurrentRun>
 #include <QUrlQuery>
 #include <QVersionNumber>
 
+#include <algorithm>
+#include <chrono>
 #include <functional>
 
 #include <sys/types.h>
@@ -58,22 +66,170 @@
 #include <unistd.h>
 #endif
 
-#ifdef KDHOCKEYAPP_QMLSUPPORT_ENABLED
-extern "C" Q_QML_EXPORT char *qt_v4StackTrace(void *);
-#endif
-
 namespace KDHockeyApp {
 
 Q_LOGGING_CATEGORY(lcHockeyApp, "kdab.kdhockeyapp")
+Q_LOGGING_CATEGORY(lcHockeyAppStartup, "kdab.kdhockeyapp.startup", QtWarningMsg)
 
 namespace {
 
 enum Necessity { Mandatory, Optional };
+enum Encoding { Plain, Compressed };
+
+struct LogTier
+{
+    const char *suffix;
+    const char *title;
+};
+
+constexpr int defaultLogCapacity = 32768;
+constexpr int defaultLogMemoryBudget = 1024 * 1024;
+constexpr int logRecordCapacity = 4096;
+constexpr int logStringsCapacity = 16384;
+constexpr int crashBundleReserve = 65536; // for section headers, and the QML stack trace
+
+// Binary logs start with this header, followed by sections of the form: tier index
+// as one byte, size as 32 bit little endian number, and that many bytes of content.
+constexpr char binaryLogHeader[] = {'K', 'D', 'H', 'A', 'L', 'O', 'G', 'B', 1, 0, 0, 0};
+
+constexpr LogTier logTiers[] = {
+    {"ring", nullptr}, // the shared buffer for all messages without dedicated buffer
+    {"ring-debug", "\n---- debug messages ----\n"},
+    {"ring-warning", "\n---- warnings ----\n"},
+    {"ring-critical", "\n---- critical messages ----\n"},
+    {"ring-fatal", "\n---- fatal messages ----\n"},
+    {"ring-info", "\n---- info messages ----\n"},
+    {"ring-strings", nullptr}, // string definitions for binary logs
+};
+
+constexpr int logTierCount = sizeof logTiers / sizeof *logTiers;
+constexpr int logStringsTier = logTierCount - 1;
+static_assert(logStringsTier == QtInfoMsg + 2, "a log tier is needed for each message type");
+
+LogBuffer logBuffer{defaultLogCapacity};
+LogBuffer logTypeBuffers[logStringsTier - 1]; // dedicated buffers per message type, empty by default
+LogBuffer logStringBuffer;
+LogStringTable logStrings{&logStringBuffer};
+int logBufferBudget = defaultLogMemoryBudget;
+
+// the log buffers are shared by all managers, but persisted with the crash files of only one of them
+const HockeyAppManager::Private *persistentLogOwner = nullptr;
+
+QString crashServerProgramPath; // empty unless out-of-process crash handling was requested
+
+qint64 miniDumpSizeLimitBytes = -1;
+bool miniDumpStackSanitizationEnabled = false;
+const void *miniDumpPrincipalMappingAddress = nullptr;
+int microDumpFallbackFileHandle = -1; // microdumps are disabled by default
+
+// the first manager writes the non-fatal reports of failed soft assertions
+QBasicMutex softAssertMutex;
+HockeyAppManager::Private *softAssertReportWriter = nullptr;
+
+const auto logClockStart = std::chrono::steady_clock::now();
+const auto logClockEpoch = std::chrono::system_clock::now();
+
+LogBuffer &logBufferAt(int tier)
+{
+    if (tier == logStringsTier)
+        return logStringBuffer;
+
+    return tier == 0 ? logBuffer : logTypeBuffers[tier - 1];
+}
+
+LogBuffer &logBufferFor(QtMsgType type)
+{
+    if (type >= 0 && type < logStringsTier - 1 && logTypeBuffers[type].capacity() > 0)
+        return logTypeBuffers[type];
+
+    return logBuffer;
+}
+
+template<class Function>
+void forEachLogBuffer(Function &&function)
+{
+    for (auto tier = 0; tier < logTierCount; ++tier) {
+        auto &buffer = logBufferAt(tier);
+
+        if (tier == 0 || buffer.capacity() > 0)
+            function(buffer, tier);
+    }
+}
+
+quint64 logTimestamp()
+{
+    using namespace std::chrono;
+    return static_cast<quint64>(duration_cast<microseconds>(steady_clock::now() - logClockStart).count());
+}
+
+bool appendLogClockDefinition()
+{
+    using namespace std::chrono;
+
+    // string id zero holds the wall clock time of timestamp zero in milliseconds since epoch
+    const auto epoch = static_cast<quint64>(duration_cast<milliseconds>(logClockEpoch.time_since_epoch()).count());
+
+    char buffer[16];
+    LogFormatter definition{buffer};
+    definition.appendVarint(0).appendVarint(8);
+
+    for (auto i = 0; i < 8; ++i)
+        definition.append(static_cast<char>(epoch >> (8 * i)));
+
+    return logStringBuffer.tryAppend(definition.data(), definition.size());
+}
+
+qint64 logMemoryUsage()
+{
+    qint64 usage = 0;
+
+    for (auto tier = 0; tier < logTierCount; ++tier)
+        usage += logBufferAt(tier).capacity();
+
+    return usage;
+}
+
+bool resizeLogBuffer(LogBuffer &buffer, int capacity)
+{
+    if (logBuffer.isMapped()) {
+        qCWarning(lcHockeyApp, "The log capacity cannot be changed while the persistent log is enabled");
+        return false;
+    }
+
+    const auto usage = logMemoryUsage() - buffer.capacity() + LogBuffer::roundedCapacity(capacity);
+
+    if (usage > logBufferBudget) {
+        qCWarning(lcHockeyApp, "Log buffers of %lld bytes would exceed the memory budget of %d bytes",
+                  static_cast<long long>(usage), logBufferBudget);
+        return false;
+    }
+
+    return buffer.resize(capacity);
+}
+
+bool writeData(int fd, const char *data, size_t length)
+{
+    // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
+    return write(fd, data, static_cast<unsigned>(length)) == static_cast<int>(length);
+}
+
+bool writeString(int fd, const char *str)
+{
+    // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
+    return writeData(fd, str, strlen(str));
+}
+
+bool isBinaryLog(QIODevice *device)
+{
+    return device->open(QIODevice::ReadOnly)
+            && device->read(sizeof binaryLogHeader) == QByteArray::fromRawData(binaryLogHeader, sizeof binaryLogHeader);
+}
 
-constexpr int logCapacity = 32768;
-QContiguousCache<char> logBuffer{logCapacity};
-QContiguousCache<char> lockedDownLogBuffer{logCapacity}; // to prevent races while writing its contents to disk
-char writeBuffer[logCapacity];
+bool isBinaryLogFile(const QString &fileName)
+{
+    QFile file{fileName};
+    return isBinaryLog(&file);
+}
 
 void messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message);
 const auto defaultMessageHandler = qInstallMessageHandler(messageHandler);
@@ -82,61 +238,78 @@ const auto s_formDataHeader = QStringLiteral(R"(form-data; name="%1"; filename="
 const auto s_formDataHeaderMeta = QStringLiteral(R"(form-data; name="log"; filename="%1.meta")");
 const auto s_restUrlUploadCrashReport =QStringLiteral("https://rink.hockeyapp.net/api/2/apps/%1/crashes/upload");
 const auto s_restUrlListVersions = QStringLiteral("https://rink.hockeyapp.net/api/2/apps/%1");
-const auto s_settingsStartTime = QStringLiteral("HockeyApp/Usage/StartTime");
 const auto s_settingsUsageDuration = QStringLiteral("HockeyApp/Usage/Duration");
 const auto s_webUrlInstallPage = QStringLiteral("https://rink.hockeyapp.net/apps/%1");
 
 void messageHandler(QtMsgType type, const QMessageLogContext &context, const QString &message)
 {
-    QString tmp;
-
-    switch (type) {
-    case QtDebugMsg:
-        tmp += "[D] "_l1;
-        break;
-    case QtWarningMsg:
-        tmp += "[W] "_l1;
-        break;
-    case QtCriticalMsg:
-        tmp += "[C] "_l1;
-        break;
-    case QtFatalMsg:
-        tmp += "[F] "_l1;
-        break;
-    case QtInfoMsg:
-        tmp += "[I] "_l1;
-        break;
-    }
-
-    if (context.category) {
-        tmp.append(QString::fromLatin1(context.category));
-        tmp.append(": "_l1);
-    }
-
-    if (context.function) {
-        tmp.append(QString::fromLatin1(context.function));
-
-        if (context.line > 0) {
-            tmp.append(", line "_l1);
-            tmp.append(QString::number(context.line));
-        }
+    char buffer[logRecordCapacity]; // format on the stack to avoid heap allocations
+    LogFormatter record{buffer};
+    auto &ring = logBufferFor(type);
+
+    if (ring.isBinary())
+        record.appendBinaryRecord(type, context, message, logTimestamp(), &logStrings);
+    else
+        record.appendTextRecord(type, context, message);
+
+    ring.append(record.data(), record.size());
+    defaultMessageHandler(type, context, message);
+}
+
+#ifdef KDHOCKEYAPP_COMPRESSION_ENABLED
+
+QIODevice *compressDevice(QIODevice *source, const QString &name, QObject *parent)
+{
+    // QHttpMultiPart needs seekable body devices of known size,
+    // therefore the compressed stream is spooled to a temporary file
+    QScopedPointer<QTemporaryFile> target{new QTemporaryFile{parent}};
+
+    if (!target->open()) {
+        qCWarning(lcHockeyApp, "Could not create temporary file to compress %ls: %ls",
+                  qUtf16Printable(name), qUtf16Printable(target->errorString()));
+        return nullptr;
+    }
 
-        tmp.append(": "_l1);
+    if (!GzipDevice::compress(source, target.data()) || !target->reset()) {
+        qCWarning(lcHockeyApp, "Could not compress %ls", qUtf16Printable(name));
+        return nullptr;
     }
 
-    tmp.append(message);
-    tmp.append('\n'_l1);
+    return target.take();
+}
 
-    const auto utf8Data = tmp.toUtf8();
-    for (auto ch: utf8Data)
-        logBuffer.append(ch);
+#endif // KDHOCKEYAPP_COMPRESSION_ENABLED
 
-    logBuffer.normalizeIndexes(); // avoid that indexes overflow
-    defaultMessageHandler(type, context, message);
+void attachDevice(QHttpMultiPart *formData, const QString &fieldName, QString uploadFileName,
+                  QIODevice *device, Encoding encoding)
+{
+    QScopedPointer<QIODevice> body{device};
+    auto contentType = "application/octet-stream"_l1;
+
+#ifdef KDHOCKEYAPP_COMPRESSION_ENABLED
+    if (encoding == Compressed) {
+        if (const auto compressedDevice = compressDevice(body.data(), uploadFileName, formData)) {
+            body.reset(compressedDevice);
+            uploadFileName += ".gz"_l1;
+            contentType = "application/gzip"_l1;
+        } else {
+            body->reset(); // fall back to the uncompressed data
+        }
+    }
+#else
+    Q_UNUSED(encoding);
+#endif
+
+    QHttpPart part;
+    part.setHeader(QNetworkRequest::ContentDispositionHeader, s_formDataHeader.arg(fieldName, uploadFileName));
+    part.setHeader(QNetworkRequest::ContentTypeHeader, contentType);
+    part.setBodyDevice(body.take());
+
+    formData->append(part);
 }
 
-bool attachFile(QHttpMultiPart *formData, const QString &fieldName,
-                const QString &fileName, QStringList *crashFiles, Necessity necessity)
+bool attachFile(QHttpMultiPart *formData, const QString &fieldName, const QString &fileName,
+                QStringList *crashFiles, Necessity necessity, Encoding encoding = Plain)
 {
     QScopedPointer<QFile> file{new QFile{fileName, formData}};
 
@@ -149,31 +322,62 @@ bool attachFile(QHttpMultiPart *formData, const QString &fieldName,
         return false;
     }
 
-    QHttpPart part;
-    part.setHeader(QNetworkRequest::ContentDispositionHeader,
-                   s_formDataHeader.arg(fieldName, QFileInfo(fileName).fileName()));
-    part.setHeader(QNetworkRequest::ContentTypeHeader, "application/octet-stream"_l1);
-    part.setBodyDevice(file.take());
-
-    formData->append(part);
+    attachDevice(formData, fieldName, QFileInfo(fileName).fileName(), file.take(), encoding);
     crashFiles->append(fileName);
 
     return true;
 }
 
-qint64 usageDuration(const QSettings &settings = QSettings{})
+bool attachSection(QHttpMultiPart *formData, const QString &fieldName, const QString &uploadFileName,
+                   const QString &bundleFileName, const CrashBundle::Section &section, Encoding encoding = Plain)
 {
-    return settings.value(s_settingsUsageDuration).toLongLong();
+    QScopedPointer<CrashBundleSection> device{new CrashBundleSection{bundleFileName, section, formData}};
+
+    if (!device->open(QIODevice::ReadOnly)) {
+        qCWarning(lcHockeyApp, "Could not open %ls to upload crash data: %ls",
+                  qUtf16Printable(bundleFileName), qUtf16Printable(device->errorString()));
+        return false;
+    }
+
+    attachDevice(formData, fieldName, uploadFileName, device.take(), encoding);
+    return true;
 }
 
-template<class Engine> auto engineContext(const Engine *engine) -> decltype(engine->currentContext())
+void writeSoftAssertReport(const char *file, int line, const char *expression, int occurrences)
 {
-    return engine->currentContext();
+    // assertions failing while another report is written, maybe even by that very report, get dropped
+    if (!softAssertMutex.tryLock())
+        return;
+
+    if (softAssertReportWriter)
+        softAssertReportWriter->writeSoftAssertReport(file, line, expression, occurrences);
+
+    softAssertMutex.unlock();
+}
+
+template<class Function>
+auto measureStartup(const char *phase, Function &&function) -> decltype(function())
+{
+    if (!lcHockeyAppStartup().isDebugEnabled())
+        return function();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    struct Report
+    {
+        ~Report() { qCDebug(lcHockeyAppStartup, "%s took %lld us", phase, timer.nsecsElapsed() / 1000); }
+
+        const char *const phase;
+        const QElapsedTimer &timer;
+    } report{phase, timer};
+
+    return function();
 }
 
-template<class Engine> auto engineContext(const Engine *engine, ...) -> decltype(engine->currentContext)
+qint64 usageDuration(const QSettings &settings = QSettings{})
 {
-    return engine->currentContext;
+    return settings.value(s_settingsUsageDuration).toLongLong();
 }
 
 } // namespace
@@ -203,68 +407,231 @@ QByteArray HockeyAppManager::AppInfo::toByteArray() const
     return appInfo;
 }
 
-bool HockeyAppManager::Private::writeLogFile(const QContiguousCache<char> &logBuffer) const
+bool HockeyAppManager::Private::writeLogFile() const
 {
     // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
 
-    const auto size = logBuffer.size();
+    const auto fd = open(logFileName.c_str(), O_CREAT | O_WRONLY, 0600);
+
+    if (fd == -1)
+        return false;
+
+    const auto succeeded = writeLogData(fd);
+    close(fd);
+
+    return succeeded;
+}
 
-    // FIXME: I wish QContiguousCache would give direct access to its data
-    for (auto i = 0; i < size; ++i)
-        writeBuffer[i] = logBuffer.at(logBuffer.firstIndex() + i);
+bool HockeyAppManager::Private::writeLogData(int fd) const
+{
+    // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
 
-    const auto fd = open(logFileName.c_str(), O_CREAT | O_WRONLY, 0600);
+    const auto binary = logBuffer.isBinary();
+    auto succeeded = !binary || writeData(fd, binaryLogHeader, sizeof binaryLogHeader);
+
+    forEachLogBuffer([fd, binary, &succeeded](const LogBuffer &buffer, int tier) {
+        if (binary) {
+            const char tag = static_cast<char>(tier);
+            succeeded &= writeData(fd, &tag, 1);
+        } else if (tier == logStringsTier) {
+            return;
+        } else if (logTiers[tier].title) {
+            succeeded &= writeString(fd, logTiers[tier].title);
+        }
+
+        succeeded &= buffer.writeTo(fd);
+    });
+
+    return succeeded;
+}
+
+bool HockeyAppManager::Private::writeBreadcrumbFile() const
+{
+    // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
+
+    if (breadcrumbs.isEmpty())
+        return true;
+
+    const auto fd = open(breadcrumbFileName.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0600);
 
     if (fd == -1)
         return false;
 
-    const auto written = write(fd, writeBuffer, static_cast<size_t>(size));
+    const auto succeeded = breadcrumbs.writeTo(fd);
     close(fd);
 
-    return written == size;
+    return succeeded;
 }
 
 bool HockeyAppManager::Private::writeMetaFile() const
 {
     // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
 
-    const auto fd = open(metaFileName.c_str(), O_CREAT | O_WRONLY, 0600);
+    const auto fd = open(metaFileName.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0600);
 
     if (fd == -1)
         return false;
 
-    const auto written = write(fd, metaData.constData(), static_cast<size_t>(metaData.size()));
+    const auto succeeded = writeMetaData(fd);
     close(fd);
 
-    return written == metaData.size();
+    return succeeded;
+}
+
+bool HockeyAppManager::Private::writeMetaData(int fd) const
+{
+    // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
+
+    const auto &data = metaData();
+    return writeData(fd, data.constData(), static_cast<size_t>(data.size()));
+}
+
+const char *HockeyAppManager::Private::qmlStackTrace() const
+{
+    // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
+    return qmlTrace.capture();
 }
 
 bool HockeyAppManager::Private::writeQmlTrace() const
 {
     // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
 
-#ifdef KDHOCKEYAPP_QMLSUPPORT_ENABLED
+    const auto stackTrace = qmlStackTrace();
 
-    if (const auto engine = qmlEngine ? QQmlEnginePrivate::getV4Engine(qmlEngine) : nullptr) {
-        const auto stackTrace = qt_v4StackTrace(engineContext(engine)); // FIXME: we should not allocate memory here!
+    // without QML engine, or without QML code running, there is no trace to write
+    if (!stackTrace)
+        return true;
 
-        if (!stackTrace)
-            return false;
+    const auto fd = open(qmlTraceFileName.c_str(), O_CREAT | O_WRONLY, 0600);
+
+    if (fd == -1)
+        return false;
 
-        const auto fd = open(qmlTraceFileName.c_str(), O_CREAT | O_WRONLY, 0600);
+    const auto succeeded = writeString(fd, stackTrace);
+    close(fd);
 
-        if (fd == -1)
-            return false;
+    return succeeded;
+}
+
+bool HockeyAppManager::Private::writeCrashBundle() const
+{
+    // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
 
-        const auto toWrite = strlen(stackTrace);
-        const auto written = write(fd, stackTrace, toWrite);
-        close(fd);
+    const auto metaDataStart = crashBundle.beginSection(CrashBundle::MetaData);
+    auto succeeded = writeMetaData(crashBundle.handle()) && crashBundle.endSection(metaDataStart);
 
-        return written == static_cast<int>(toWrite);
+    // the kernel takes care of persistent logs, they get converted when uploading the crash report
+    if (persistentLogOwner != this) {
+        const auto start = crashBundle.beginSection(CrashBundle::Log);
+        succeeded &= writeLogData(crashBundle.handle()) && crashBundle.endSection(start);
     }
 
-#endif // KDHOCKEYAPP_QMLSUPPORT_ENABLED
+    if (!breadcrumbs.isEmpty()) {
+        const auto start = crashBundle.beginSection(CrashBundle::Breadcrumbs);
+        succeeded &= breadcrumbs.writeTo(crashBundle.handle()) && crashBundle.endSection(start);
+    }
+
+    if (const auto stackTrace = qmlStackTrace()) {
+        const auto start = crashBundle.beginSection(CrashBundle::QmlTrace);
+        succeeded &= writeString(crashBundle.handle(), stackTrace) && crashBundle.endSection(start);
+    }
+
+    return succeeded;
+}
+
+/*!
+    Writes a non-fatal report for the soft assertion \a expression in \a file at
+    \a line, which failed \a occurrences times since its last report. The report
+    consists of a minidump of the running process, and the usual meta data, log
+    and breadcrumbs. It gets uploaded like any crash report.
+
+    The minidump gets written to a staging directory, and only moved to the crash
+    directory once the other files are complete. Uploads must not pick up partial
+    reports. No report is written while the crash spool is full.
+*/
+bool HockeyAppManager::Private::writeSoftAssertReport(const char *file, int line, const char *expression,
+                                                      int occurrences)
+{
+    if (crashSpool.isFull()) {
+        qCWarning(lcHockeyApp, "Skipping report for failed soft assertion, the crash spool is full");
+        return false;
+    }
+
+    const QDir dataDir{dataDirPath()};
+    const auto stagingDirPath = dataDir.filePath("staging"_l1);
+
+    if (!dataDir.mkpath(stagingDirPath)) {
+        qCWarning(lcHockeyApp, "Could not create staging directory for failed soft assertion");
+        return false;
+    }
 
+    const auto stagedDumpFileName = writeMiniDumpSnapshot(stagingDirPath);
+
+    if (stagedDumpFileName.isEmpty()) {
+        qCWarning(lcHockeyApp, "Could not write minidump for failed soft assertion");
+        return false;
+    }
+
+    const auto dumpFileName = dataDir.filePath(QFileInfo{stagedDumpFileName}.fileName());
+    const auto commonFileName = dumpFileName.left(dumpFileName.length() - 3);
+    auto metaData = this->metaData();
+    const auto headerEnd = metaData.indexOf("\n\n");
+
+    if (headerEnd >= 0) {
+        auto header = "Soft Assertion: " + QByteArray{expression} + " ("
+                + QByteArray{file} + ':' + QByteArray::number(line) + ")\n";
+
+        if (occurrences > 1)
+            header += "Occurrences: " + QByteArray::number(occurrences) + '\n';
+
+        metaData.insert(headerEnd + 1, header);
+    }
+
+    QFile metaFile{commonFileName + "dsc"_l1};
+    QFile logFile{commonFileName + "log"_l1};
+
+    if (!metaFile.open(QFile::WriteOnly) || metaFile.write(metaData) != metaData.size()
+            || !logFile.open(QFile::WriteOnly)) {
+        qCWarning(lcHockeyApp, "Could not write report for failed soft assertion: %ls",
+                  qUtf16Printable(metaFile.isOpen() ? logFile.errorString() : metaFile.errorString()));
+        QFile::remove(metaFile.fileName());
+        QFile::remove(stagedDumpFileName);
+        return false;
+    }
+
+    // the log must not change while being copied
+    forEachLogBuffer([](LogBuffer &buffer, int) {
+        buffer.lockDown();
+    });
+
+    writeLogData(logFile.handle());
+
+    forEachLogBuffer([](LogBuffer &buffer, int) {
+        buffer.release();
+    });
+
+    metaFile.close();
+    logFile.close();
+
+    QFile breadcrumbFile{commonFileName + "bcr"_l1};
+
+    if (!breadcrumbs.isEmpty() && breadcrumbFile.open(QFile::WriteOnly)) {
+        breadcrumbs.writeTo(breadcrumbFile.handle());
+        breadcrumbFile.close();
+    }
+
+    // publish the report
+    if (!QFile::rename(stagedDumpFileName, dumpFileName)) {
+        qCWarning(lcHockeyApp, "Could not move minidump for failed soft assertion to %ls",
+                  qUtf16Printable(dumpFileName));
+        QFile::remove(metaFile.fileName());
+        QFile::remove(logFile.fileName());
+        QFile::remove(breadcrumbFile.fileName());
+        QFile::remove(stagedDumpFileName);
+        return false;
+    }
+
+    crashSpool.scheduleUpdate();
     return true;
 }
 
@@ -276,13 +643,90 @@ bool HockeyAppManager::Private::writeCrashReport(bool minidumpWritten) const
     }
 
     // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
-    logBuffer.swap(lockedDownLogBuffer); // prevent any writes while we are dumping it
+
+    // prevent any writes while we are dumping the log
+    forEachLogBuffer([](LogBuffer &buffer, int) {
+        buffer.lockDown();
+    });
+
+    if (crashBundle.isOpen())
+        return writeCrashBundle();
+
+    if (persistentLogOwner == this) {
+        // The meta file was written in advance, and the kernel takes care of the log file.
+        // It gets converted when uploading the crash report.
+        return writeBreadcrumbFile()
+                && writeQmlTrace();
+    }
 
     return writeMetaFile()
-            && writeLogFile(lockedDownLogBuffer)
+            && writeLogFile()
+            && writeBreadcrumbFile()
             && writeQmlTrace();
 }
 
+bool HockeyAppManager::Private::recoverLogFile(const QString &commonFileName)
+{
+    QFile logFile{commonFileName + "log"_l1};
+    const auto binary = LogBuffer::isBinaryFile(QFile::encodeName(commonFileName + QLatin1String{logTiers[0].suffix}).constData());
+    auto recovered = false;
+
+    for (auto tier = 0; tier < logTierCount; ++tier) {
+        const auto ringFileName = commonFileName + QLatin1String{logTiers[tier].suffix};
+
+        if (!QFile::exists(ringFileName))
+            continue;
+
+        if (!logFile.isOpen()) {
+            if (!logFile.open(QFile::WriteOnly | QFile::Unbuffered)) {
+                qCWarning(lcHockeyApp, "Could not create %ls: %ls",
+                          qUtf16Printable(logFile.fileName()), qUtf16Printable(logFile.errorString()));
+                return false;
+            }
+
+            if (binary)
+                logFile.write(binaryLogHeader, sizeof binaryLogHeader);
+        }
+
+        if (binary) {
+            logFile.putChar(static_cast<char>(tier));
+        } else if (tier == logStringsTier) {
+            QFile::remove(ringFileName);
+            continue;
+        } else if (logTiers[tier].title) {
+            logFile.write(logTiers[tier].title);
+        }
+
+        if (LogBuffer::recoverFile(QFile::encodeName(ringFileName).constData(), logFile.handle()))
+            recovered = true;
+        else
+            qCWarning(lcHockeyApp, "Could not recover crash log from %ls", qUtf16Printable(ringFileName));
+
+        QFile::remove(ringFileName);
+    }
+
+    return recovered;
+}
+
+void HockeyAppManager::Private::removeOrphanedCrashData(const QString &ownCommonFileName)
+{
+    // Persistent logs and crash bundles of sessions that ended without writing a mini dump, be it because
+    // the application has been killed, or because it quit without destroying HockeyAppManager.
+    for (QDirIterator it{dataDirPath(), {"*.ring*"_l1, "*.kdh"_l1}}; it.hasNext(); ) {
+        const auto fileName = it.next();
+        const auto commonFileName = fileName.left(fileName.lastIndexOf('.'_l1) + 1);
+
+        if (commonFileName == ownCommonFileName
+                || QFile::exists(commonFileName + "dmp"_l1)
+                || LogBuffer::isFileInUse(QFile::encodeName(fileName).constData()))
+            continue;
+
+        qCInfo(lcHockeyApp, "Removing orphaned crash data %ls", qUtf16Printable(fileName));
+        QFile::remove(commonFileName + "dsc"_l1);
+        QFile::remove(fileName);
+    }
+}
+
 QString HockeyAppManager::Private::dataDirPath()
 {
     return cacheLocation().filePath("crashes"_l1);
@@ -305,9 +749,40 @@ HockeyAppManager::AppInfo HockeyAppManager::Private::makeAppInfo()
     return appInfo;
 }
 
+/*!
+    Creates application information that is cheap to collect, for crashes
+    happening before collectAppInfo() completed the information.
+*/
+HockeyAppManager::AppInfo HockeyAppManager::Private::makeBasicAppInfo()
+{
+    AppInfo appInfo;
+
+    appInfo.packageName = qApp->applicationName();
+    appInfo.versionName = qApp->applicationVersion();
+
+    return appInfo;
+}
+
+/*!
+    Collects the complete application information, which might be expensive.
+    The crash handler picks up this information once it is available.
+*/
+void HockeyAppManager::Private::collectAppInfo()
+{
+    if (m_metaData.load() == &m_completeMetaData)
+        return;
+
+    m_completeMetaData = makeAppInfo().toByteArray();
+    m_metaData.store(&m_completeMetaData, std::memory_order_release);
+
+    // the meta file written in advance for the persistent log must be updated
+    if (persistentLogOwner == this && !writeMetaFile())
+        qCWarning(lcHockeyApp, "Could not write meta file %s", metaFileName.c_str());
+}
+
 std::string HockeyAppManager::Private::makeCrashFileName(const std::string &suffix) const
 {
-    std::string fileName{nextMiniDumpFileName()};
+    std::string fileName{crashFileTemplate};
 
     if (fileName.length() < 40) {
         qCWarning(lcHockeyApp, "Invalid dump file name: %s", fileName.c_str());
@@ -362,44 +837,241 @@ QNetworkAccessManager *HockeyAppManager::Private::networkAccessManager()
 */
 
 HockeyAppManager::HockeyAppManager(const QString &appId, QObject *parent)
+    : HockeyAppManager{appId, Initialization::Immediate, parent}
+{}
+
+/*!
+    \enum HockeyAppManager::Initialization
+
+    This enum describes when the manager performs the more expensive parts
+    of its initialization.
+
+    \value Immediate Everything is initialized by the constructor.
+    \value Deferred The constructor only installs the crash handler and
+           prepares the crash directory. Collecting the application information
+           is deferred until control returns to the event loop. Crashes happening
+           before report the application's name and version only.
+
+    The time taken by each phase is reported to the \c kdab.kdhockeyapp.startup
+    logging category, if debug output is enabled for it.
+*/
+
+/*!
+    Constructs a manager for the HockeyApp application \a appId, which uses
+    the \a initialization strategy.
+*/
+HockeyAppManager::HockeyAppManager(const QString &appId, Initialization initialization, QObject *parent)
     : QObject{parent}
-    , d{Private::create(appId, this)}
+    , d{measureStartup("Installing the crash handler", [&] { return Private::create(appId, this); })}
 {
     if (appId.isEmpty())
         qCWarning(lcHockeyApp, "Non-empty application id required");
 
-    const QFileInfo crashDir{d->dataDirPath()};
+    {
+        const QMutexLocker locker{&softAssertMutex};
+
+        if (!softAssertReportWriter) {
+            softAssertReportWriter = d;
+            ::KDHockeyApp::Private::setSoftAssertReporter(&writeSoftAssertReport);
+        }
+    }
+
+    measureStartup("Preparing the crash directory", [this] {
+        const QFileInfo crashDir{d->dataDirPath()};
 
-    if (!crashDir.exists())
-        QDir::current().mkpath(crashDir.filePath());
-    if (!crashDir.isWritable())
-        qCWarning(lcHockeyApp, "Crash dump directory doesn't seem writable: %ls", qUtf16Printable(d->dataDirPath()));
+        if (!crashDir.exists())
+            QDir::current().mkpath(crashDir.filePath());
+        if (!crashDir.isWritable())
+            qCWarning(lcHockeyApp, "Crash dump directory doesn't seem writable: %ls", qUtf16Printable(d->dataDirPath()));
+    });
 
     // start usage time tracking
-    QSettings{}.setValue(s_settingsStartTime, QDateTime::currentMSecsSinceEpoch());
-    connect(qApp, &QCoreApplication::aboutToQuit, this, [] {
-        QSettings settings;
+    const auto startTime = QDateTime::currentMSecsSinceEpoch();
 
-        const auto startTime = settings.value(s_settingsStartTime).toLongLong();
+    connect(qApp, &QCoreApplication::aboutToQuit, this, [startTime] {
+        QSettings settings;
 
-        if (startTime > 0) {
-            const auto currentUsage = QDateTime::currentMSecsSinceEpoch() - startTime;
-            settings.setValue(s_settingsUsageDuration, usageDuration(settings) + currentUsage);
-        }
+        const auto currentUsage = QDateTime::currentMSecsSinceEpoch() - startTime;
+        settings.setValue(s_settingsUsageDuration, usageDuration(settings) + currentUsage);
     });
+
+    const auto initialize = [this] {
+        measureStartup("Collecting application information", [this] {
+            d->collectAppInfo();
+        });
+    };
+
+    if (initialization == Initialization::Deferred)
+        QTimer::singleShot(0, this, initialize);
+    else
+        initialize();
 }
 
 HockeyAppManager::~HockeyAppManager()
 {
+    {
+        const QMutexLocker locker{&softAssertMutex};
+
+        if (softAssertReportWriter == d) {
+            ::KDHockeyApp::Private::setSoftAssertReporter(nullptr);
+            softAssertReportWriter = nullptr;
+        }
+    }
+
+    setPersistentLogEnabled(false);
     delete d;
 }
 
-
 /*!
-    \fn void HockeyAppManager::setNetworkAccessManager(QNetworkAccessManager *manager)
+    \fn void HockeyAppManager::setCrashServerProgram(const QString &program)
 
-    Set the QNetworkAccessManager to use for network requests. If none is set
-    by the user a new QNetworkAccessManager is created automatically.
+    Requests out-of-process crash handling by the crash server helper \a program,
+    which usually is the \c crashserver tool shipped with this library.
+
+    Instead of writing the minidump itself, the crashing process then only writes
+    its log and meta data, and asks the helper to write the minidump. This avoids
+    cloning and ptracing the dying process, which reduces crash handling latency
+    and memory pressure. The helper's socket is inherited by child processes, so
+    that all worker processes creating their own manager share the same helper.
+
+    This function must be called before the first manager is constructed. An
+    empty \a program requests in-process crash handling, which is the default.
+    Processes that inherited a crash server socket always use that server.
+
+    \note Out-of-process crash handling is only supported on Linux.
+*/
+
+void HockeyAppManager::setCrashServerProgram(const QString &program)
+{
+    crashServerProgramPath = program;
+}
+
+QString HockeyAppManager::crashServerProgram()
+{
+    return crashServerProgramPath;
+}
+
+/*!
+    \fn void HockeyAppManager::setMiniDumpSizeLimit(qint64 limit)
+
+    Limits the size of minidumps to roughly \a limit bytes. A negative \a limit,
+    which is the default, disables the limit.
+
+    Processes with many threads easily produce minidumps of several megabytes,
+    which take long to write and to upload. When the estimated size of a minidump
+    exceeds the limit, only the first 20 threads get their full stack recorded.
+    The stacks of all other threads get trimmed to their innermost 2 KiB, which
+    still is enough for seeing the top-most frames. The thread list, the loaded
+    modules and the crashing thread's stack are never trimmed.
+
+    This function must be called before the first manager is constructed.
+
+    \note Minidump size limits are only supported on Linux and Android. They do
+    not apply to minidumps written by an out-of-process crash server.
+*/
+
+void HockeyAppManager::setMiniDumpSizeLimit(qint64 limit)
+{
+    miniDumpSizeLimitBytes = qMax<qint64>(limit, -1);
+}
+
+qint64 HockeyAppManager::miniDumpSizeLimit()
+{
+    return miniDumpSizeLimitBytes;
+}
+
+/*!
+    \fn void HockeyAppManager::setMiniDumpStackSanitizationEnabled(bool enabled)
+
+    Replaces all values on the recorded thread stacks that neither look like
+    pointers into executable code or into the stack itself, nor like small
+    integers, if \a enabled. This removes most user data, such as passwords
+    and personal data, from minidumps, while keeping the information needed
+    for unwinding the stacks. The size of the minidumps is not affected.
+    Stack sanitization is disabled by default.
+
+    This function must be called before the first manager is constructed.
+
+    \note Stack sanitization is supported on Linux, Android and Windows. It does
+    not apply to minidumps written by an out-of-process crash server.
+*/
+
+void HockeyAppManager::setMiniDumpStackSanitizationEnabled(bool enabled)
+{
+    miniDumpStackSanitizationEnabled = enabled;
+}
+
+bool HockeyAppManager::isMiniDumpStackSanitizationEnabled()
+{
+    return miniDumpStackSanitizationEnabled;
+}
+
+/*!
+    \fn void HockeyAppManager::setMiniDumpPrincipalMapping(const void *address)
+
+    Restricts minidumps to crashes involving the executable or library that
+    contains \a address, e.g. the address of some function of the application.
+
+    Crashes in which neither the crashing instruction nor the crashing thread's
+    stack refer to that module are not reported at all: Neither a minidump nor a
+    microdump is written, and files written in advance, like the persistent log,
+    are deleted as orphans by the next uploadCrashDumps(). The stacks of other
+    threads that do not refer to that module are omitted from the minidump. A
+    null \a address, which is the default, disables this filter.
+
+    This function must be called before the first manager is constructed.
+
+    \note Principal mapping filters are only supported on Linux and Android. They
+    do not apply to minidumps written by an out-of-process crash server.
+*/
+
+void HockeyAppManager::setMiniDumpPrincipalMapping(const void *address)
+{
+    miniDumpPrincipalMappingAddress = address;
+}
+
+const void *HockeyAppManager::miniDumpPrincipalMapping()
+{
+    return miniDumpPrincipalMappingAddress;
+}
+
+/*!
+    \fn void HockeyAppManager::setMicroDumpFallbackHandle(int handle)
+
+    Writes a microdump to the file descriptor \a handle for crashes that cannot
+    be stored as regular crash report. This happens when the crash directory is
+    not writable, when its quota is exhausted, or when writing the minidump
+    failed, e.g. because the disk is full.
+
+    Microdumps are a compact text form of the crashing thread's stack and the
+    loaded modules. They only take a fraction of the time and I/O needed for a
+    minidump, but they are not uploaded automatically. Pass \c STDERR_FILENO to
+    have them harvested with the application's log, where Breakpad's
+    \c microdump_stackwalk tool can symbolize them. A negative \a handle, which
+    is the default, disables microdumps.
+
+    This function must be called before the first manager is constructed.
+    The file descriptor must stay open for the lifetime of the process.
+
+    \note Microdumps are only supported on Linux.
+*/
+
+void HockeyAppManager::setMicroDumpFallbackHandle(int handle)
+{
+    microDumpFallbackFileHandle = qMax(handle, -1);
+}
+
+int HockeyAppManager::microDumpFallbackHandle()
+{
+    return microDumpFallbackFileHandle;
+}
+
+
+/*!
+    \fn void HockeyAppManager::setNetworkAccessManager(QNetworkAccessManager *manager)
+
+    Set the QNetworkAccessManager to use for network requests. If none is set
+    by the user a new QNetworkAccessManager is created automatically.
 */
 
 void HockeyAppManager::setNetworkAccessManager(QNetworkAccessManager *manager)
@@ -423,79 +1095,660 @@ QNetworkAccessManager *HockeyAppManager::networkAccessManager() const
 
 void HockeyAppManager::setQmlEngine(QQmlEngine *engine)
 {
-    d->qmlEngine = engine;
+    d->qmlTrace.setEngine(engine);
 }
 
 QQmlEngine *HockeyAppManager::qmlEngine() const
 {
-    return d->qmlEngine;
+    return d->qmlTrace.engine();
 }
 
 #endif // KDHOCKEYAPP_QMLSUPPORT_ENABLED
 
+/*!
+    \fn bool HockeyAppManager::setLogCapacity(int capacity)
+
+    Sets the \a capacity in bytes of the log buffer which is attached to
+    crash reports. Messages of types with a dedicated buffer are not stored
+    in this buffer. The capacity gets rounded up to the next power of two.
+    The buffer is allocated immediately, so that no memory must be allocated
+    when logging or when writing crash reports.
+
+    Returns \c false if the new capacity would exceed the logMemoryBudget(),
+    or if the persistent log is enabled. The default capacity is 32 KiB.
+
+    \sa setLogMemoryBudget(), setPersistentLogEnabled()
+*/
+
+bool HockeyAppManager::setLogCapacity(int capacity)
+{
+    return resizeLogBuffer(logBuffer, capacity);
+}
+
+int HockeyAppManager::logCapacity() const
+{
+    return logBuffer.capacity();
+}
+
+/*!
+    \fn bool HockeyAppManager::setLogCapacity(QtMsgType type, int capacity)
+
+    Gives messages of the given \a type a dedicated log buffer of \a capacity
+    bytes. This way for instance warnings and critical messages survive
+    a flood of debug messages. A \a capacity of zero removes the dedicated
+    buffer, so that messages of this \a type get stored in the shared buffer
+    again. The contents of dedicated buffers are attached to the crash log
+    in separate sections.
+
+    \sa setLogCapacity(int)
+*/
+
+bool HockeyAppManager::setLogCapacity(QtMsgType type, int capacity)
+{
+    if (type < 0 || type >= logStringsTier - 1) {
+        qCWarning(lcHockeyApp, "Unsupported message type: %d", type);
+        return false;
+    }
+
+    return resizeLogBuffer(logTypeBuffers[type], capacity);
+}
+
+int HockeyAppManager::logCapacity(QtMsgType type) const
+{
+    return &logBufferFor(type) == &logBuffer ? 0 : logTypeBuffers[type].capacity();
+}
+
+/*!
+    \fn bool HockeyAppManager::setLogMemoryBudget(int budget)
+
+    Sets the maximum amount of memory in bytes that all log buffers may
+    allocate together. Capacity changes exceeding this \a budget are
+    refused up front. Returns \c false if the current buffers already
+    exceed the new \a budget. The default budget is 1 MiB.
+*/
+
+bool HockeyAppManager::setLogMemoryBudget(int budget)
+{
+    if (logMemoryUsage() > budget) {
+        qCWarning(lcHockeyApp, "Log buffers already use more than %d bytes", budget);
+        return false;
+    }
+
+    logBufferBudget = budget;
+    return true;
+}
+
+int HockeyAppManager::logMemoryBudget() const
+{
+    return logBufferBudget;
+}
+
+/*!
+    \enum HockeyAppManager::LogFormat
+
+    This enum describes how messages are stored in the crash log.
+
+    \value Text Messages are stored as formatted text, which is attached
+           as description to crash reports.
+    \value Binary Messages are stored as compact binary records. Category
+           and function names are stored only once, timestamps are taken
+           from a monotonic clock, numbers are stored as varints. This fits
+           significantly more history into the same capacity. Such logs are
+           attached as file to crash reports and can be converted back to
+           text by the \c decodelog tool.
+*/
+
+/*!
+    \fn bool HockeyAppManager::setLogFormat(LogFormat format)
+
+    Sets the \a format of the crash log. Changing the format clears all log
+    buffers. Switching to binary logs the first time allocates the buffer
+    for category and function names, which counts towards logMemoryBudget().
+*/
+
+bool HockeyAppManager::setLogFormat(LogFormat format)
+{
+    const auto binary = (format == LogFormat::Binary);
+
+    if (binary == logBuffer.isBinary())
+        return true;
+
+    if (binary && logStringBuffer.capacity() == 0) {
+        if (!resizeLogBuffer(logStringBuffer, logStringsCapacity))
+            return false;
+
+        logStringBuffer.setBinary(true);
+        appendLogClockDefinition();
+    }
+
+    auto succeeded = true;
+
+    // also flag empty buffers, so that they keep the format when getting resized later
+    for (auto tier = 0; tier < logStringsTier; ++tier)
+        succeeded &= logBufferAt(tier).setBinary(binary);
+
+    return succeeded;
+}
+
+HockeyAppManager::LogFormat HockeyAppManager::logFormat() const
+{
+    return logBuffer.isBinary() ? LogFormat::Binary : LogFormat::Text;
+}
+
+/*!
+    \fn void HockeyAppManager::setPersistentLogEnabled(bool enabled)
+
+    Controls whether the crash log is kept in memory mapped files.
+
+    By default the crash log is kept in anonymous memory and gets written
+    to disk by the crash handler. When \a enabled is \c true the log buffers
+    are moved into shared memory mappings of files in the crash directory.
+    The kernel then persists the log even if the crash handler doesn't get
+    a chance to run completely, and no log must be written at crash time.
+    The files get removed when HockeyAppManager is destroyed.
+
+    The log buffers are shared by all managers of the process, but only one
+    manager at a time can keep them in its crash directory. Other managers
+    cannot enable the persistent log until that manager disables it, or gets
+    destroyed.
+
+    \note Persistent logs are only supported on Unix platforms.
+    \note Log capacities cannot be changed while the persistent log is enabled.
+*/
+
+void HockeyAppManager::setPersistentLogEnabled(bool enabled)
+{
+    if (enabled == isPersistentLogEnabled())
+        return;
+
+    if (persistentLogOwner && persistentLogOwner != d) {
+        qCWarning(lcHockeyApp, "The persistent log is already enabled by another manager");
+        return;
+    }
+
+    if (enabled) {
+        auto succeeded = true;
+
+        forEachLogBuffer([this, &succeeded](LogBuffer &buffer, int tier) {
+            const auto fileName = d->makeCrashFileName(logTiers[tier].suffix);
+
+            if (succeeded && !buffer.mapFile(fileName.c_str())) {
+                qCWarning(lcHockeyApp, "Could not map persistent log file %s", fileName.c_str());
+                succeeded = false;
+            }
+        });
+
+        // also after failures, so that the files mapped so far get unmapped
+        persistentLogOwner = d;
+
+        if (!succeeded) {
+            setPersistentLogEnabled(false);
+            return;
+        }
+
+        // the meta file is needed to report crashes for which the crash handler didn't complete
+        if (!d->writeMetaFile())
+            qCWarning(lcHockeyApp, "Could not write meta file %s", d->metaFileName.c_str());
+    } else {
+        persistentLogOwner = nullptr;
+
+        forEachLogBuffer([this](LogBuffer &buffer, int tier) {
+            const auto fileName = d->makeCrashFileName(logTiers[tier].suffix);
+
+            if (buffer.isMapped() && !buffer.unmapFile())
+                qCWarning(lcHockeyApp, "Could not unmap persistent log file %s", fileName.c_str());
+
+            QFile::remove(QString::fromStdString(fileName));
+        });
+
+        QFile::remove(QString::fromStdString(d->metaFileName));
+    }
+}
+
+bool HockeyAppManager::isPersistentLogEnabled() const
+{
+    return persistentLogOwner == d;
+}
+
+/*!
+    \fn bool HockeyAppManager::setCrashBundleEnabled(bool enabled)
+
+    Enables single file crash bundles if \a enabled is \c true.
+
+    By default the crash handler writes the meta data, the log, the breadcrumbs
+    and the QML stack trace into separate files next to the minidump. In bundle
+    mode these are written as sections of a single file instead, which is
+    created and preallocated in advance. This reduces the work done by the
+    crash handler to writing into an already open file, and cleaning up after
+    an upload to deleting that file. The minidump itself still is a separate
+    file.
+
+    Returns \c false if the bundle file could not be created.
+*/
+
+bool HockeyAppManager::setCrashBundleEnabled(bool enabled)
+{
+    if (!enabled) {
+        d->crashBundle.remove();
+        return true;
+    }
+
+    if (d->crashBundle.isOpen())
+        return true;
+
+    const auto fileName = d->makeCrashFileName("kdh");
+    const auto preallocatedSize = logMemoryUsage() + d->metaData().size() + d->breadcrumbs.dumpSize() + crashBundleReserve;
+
+    if (!d->crashBundle.create(fileName, preallocatedSize)) {
+        qCWarning(lcHockeyApp, "Could not create crash bundle %s", fileName.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool HockeyAppManager::isCrashBundleEnabled() const
+{
+    return d->crashBundle.isOpen();
+}
+
+/*!
+    \fn void HockeyAppManager::addBreadcrumb(BreadcrumbType type, const char *message, int size)
+
+    Records a breadcrumb of \a type, such as navigating to another page, sending
+    a network request or some user action. The breadcrumb is described by the
+    first \a size bytes of \a message, which should be UTF-8 encoded. A negative
+    \a size stands for the entire null-terminated \a message.
+
+    The most recent 256 breadcrumbs are attached to crash reports. They are kept
+    apart from the log, so that they cannot be pushed out by chatty messages.
+    Each breadcrumb is stored with a timestamp in a fixed-size record, which
+    truncates messages to 104 bytes. Recording breadcrumbs is thread-safe, and
+    cheap enough for hot paths: it neither locks nor allocates memory.
+
+    The decodelog tool converts the attached breadcrumbs into text.
+*/
+
+void HockeyAppManager::addBreadcrumb(BreadcrumbType type, const char *message, int size)
+{
+    if (size < 0)
+        size = static_cast<int>(qstrlen(message));
+
+    d->breadcrumbs.append(static_cast<int>(type), message, size);
+}
+
 /*!
     \fn void HockeyAppManager::uploadCrashDumps() const
 
     Upload all previously written crash reports to HockeyApp.
+
+    The reports are queued and uploaded newest first, with at most
+    maximumConcurrentUploads() uploads running at the same time. Failed
+    uploads are retried with exponentially growing delays. The number of
+    attempts is remembered across application restarts, so that broken
+    reports are given up and deleted eventually. Reports rejected by the
+    server are deleted without retrying. Scanning the crash directory and
+    reading the reports happens on worker threads, so that this function
+    returns immediately.
+
+    \sa crashDumpUploadStarted(), crashDumpUploaded(), crashDumpUploadFailed(), crashDumpUploadProgress()
 */
 
 void HockeyAppManager::uploadCrashDumps() const
 {
     qCInfo(lcHockeyApp, "Searching for crashdumps in %ls", qUtf16Printable(d->dataDirPath()));
-    for (QDirIterator it{d->dataDirPath(), {"*.dmp"_l1}}; it.hasNext(); )
-        uploadCrashDump(it.next());
+    d->uploadQueue.enqueueCrashDumps(d->dataDirPath());
+    d->crashSpool.scheduleUpdate();
+    QtConcurrent::run(&Private::removeOrphanedCrashData, QString::fromStdString(d->makeCrashFileName({})));
+}
+
+/*!
+    \fn void HockeyAppManager::setCrashSpoolQuota(qint64 maximumSize, int maximumCount)
+
+    Limits the crash directory to \a maximumSize bytes and \a maximumCount
+    crash reports. Without quota, reports which fail to upload pile up forever.
+    A limit of zero disables that part of the quota, which is the default.
+
+    When there is no room left for another report of average size, the oldest
+    reports get deleted until there is. Reports which are being uploaded are
+    kept, deleted reports are removed from the upload queue. This happens on a
+    worker thread, now and whenever uploadCrashDumps() is called. Until then,
+    no minidumps are written for crashes at all, so that crash loops cannot
+    fill the storage.
+
+    \note On Linux the quota doesn't apply to processes using a crash server,
+    which writes their minidumps into its own directory.
+
+    The sizes of the reports are tracked in the \c spool.ini file of the crash
+    directory, so that only new reports need to be inspected.
+*/
+
+void HockeyAppManager::setCrashSpoolQuota(qint64 maximumSize, int maximumCount)
+{
+    d->crashSpool.setQuota(maximumSize, maximumCount);
+    d->crashSpool.scheduleUpdate();
+}
+
+qint64 HockeyAppManager::crashSpoolMaximumSize() const
+{
+    return d->crashSpool.maximumSize();
+}
+
+int HockeyAppManager::crashSpoolMaximumCount() const
+{
+    return d->crashSpool.maximumCount();
+}
+
+/*!
+    \fn void HockeyAppManager::setMaximumConcurrentUploads(int count)
+
+    Limits the number of crash reports uploaded at the same time by
+    uploadCrashDumps() to \a count. The default is two uploads.
+*/
+
+void HockeyAppManager::setMaximumConcurrentUploads(int count)
+{
+    d->uploadQueue.setMaximumActiveUploads(count);
+}
+
+int HockeyAppManager::maximumConcurrentUploads() const
+{
+    return d->uploadQueue.maximumActiveUploads();
+}
+
+/*!
+    \fn void HockeyAppManager::setDuplicateCrashLimit(int limit)
+
+    Limits the number of full reports uploadCrashDumps() sends for the same crash
+    to \a limit. Crash loops, where the same bug fires on every launch, otherwise
+    produce a flood of near-identical reports.
+
+    Crashes are recognized by a signature computed from the top frames of the
+    crashing thread. Once the limit is reached only a sampled subset of further
+    repeats is uploaded, namely those whose running count is a power of two.
+    The others are deleted, and counted in the \c Occurrences field of the next
+    uploaded report. The counts are kept in the \c signatures.ini file of the
+    crash directory.
+
+    A \a limit of zero uploads every report, which is the default.
+*/
+
+void HockeyAppManager::setDuplicateCrashLimit(int limit)
+{
+    d->crashSignatures.setFullReportLimit(qMax(0, limit));
+}
+
+int HockeyAppManager::duplicateCrashLimit() const
+{
+    return d->crashSignatures.fullReportLimit();
+}
+
+/*!
+    \fn void HockeyAppManager::setSoftAssertReportLimit(int burst, int interval)
+
+    Enables non-fatal reports for failed soft assertions. Such a report consists
+    of a minidump of the running process, taken on the thread whose assertion
+    failed, and the usual meta data, log and breadcrumbs. Its meta data names the
+    failed assertion. The report gets uploaded like any crash report.
+
+    Writing a minidump takes a while, therefore reports are rate limited for each
+    assertion: up to \a burst reports get written in a row, after which another
+    report becomes available every \a interval seconds. Failures in between are
+    only logged, and counted in the \c Occurrences field of the next report.
+
+    A \a burst of zero disables these reports, which is the default.
+
+    \note Non-fatal reports are not supported on iOS.
+*/
+
+void HockeyAppManager::setSoftAssertReportLimit(int burst, int interval)
+{
+    ::KDHockeyApp::Private::setSoftAssertReportLimit(burst, interval);
+}
+
+int HockeyAppManager::softAssertReportBurst() const
+{
+    return ::KDHockeyApp::Private::softAssertReportBurst();
+}
+
+int HockeyAppManager::softAssertReportInterval() const
+{
+    return ::KDHockeyApp::Private::softAssertReportInterval();
+}
+
+/*!
+    \fn void HockeyAppManager::setUploadCompressionEnabled(bool enabled)
+
+    Enables gzip compression of crash report attachments if \a enabled is
+    \c true. Minidumps mostly consist of zero padded stacks and module tables,
+    therefore they compress very well. Compressed attachments get the \c .gz
+    suffix. A text log is still sent uncompressed, as it gets used as the
+    report's description. Compression is disabled by default, since the
+    server must be prepared to accept compressed attachments.
+
+    Returns \c false if the library was built without compression support.
+*/
+
+bool HockeyAppManager::setUploadCompressionEnabled(bool enabled)
+{
+#ifdef KDHOCKEYAPP_COMPRESSION_ENABLED
+    d->uploadCompressionEnabled = enabled;
+    return true;
+#else
+    if (enabled)
+        qCWarning(lcHockeyApp, "KDHockeyApp was built without compression support");
+
+    return !enabled;
+#endif
 }
 
+bool HockeyAppManager::isUploadCompressionEnabled() const
+{
+    return d->uploadCompressionEnabled;
+}
+
+/*!
+    \fn void HockeyAppManager::crashDumpUploadStarted(const QString &crashId)
+
+    This signal is emitted when the crash report \a crashId has been
+    prepared and its upload has been started.
+*/
+
+/*!
+    \fn void HockeyAppManager::crashDumpUploaded(const QString &crashId)
+
+    This signal is emitted when the crash report \a crashId was uploaded
+    by uploadCrashDumps().
+*/
+
+/*!
+    \fn void HockeyAppManager::crashDumpUploadFailed(const QString &crashId, const QString &errorString)
+
+    This signal is emitted when uploadCrashDumps() failed to upload the crash
+    report \a crashId. The reason is described by \a errorString.
+*/
+
+/*!
+    \fn void HockeyAppManager::crashDumpUploadProgress(int completed, int total)
+
+    This signal is emitted whenever uploadCrashDumps() finished with one of
+    the \a total crash reports it queued. The \a completed count includes
+    reports which have been given up.
+*/
+
+/*!
+    \fn QNetworkReply *HockeyAppManager::uploadCrashDump(const QString &dumpFileName) const
+
+    Immediately uploads the crash report \a dumpFileName, without
+    any queuing or retries. Returns \c nullptr if the report is incomplete.
+
+    \note The report is prepared on the calling thread, which involves
+    reading and possibly compressing its files. Prefer uploadCrashDumps(),
+    which prepares reports on a worker thread.
+*/
+
 QNetworkReply *HockeyAppManager::uploadCrashDump(const QString &dumpFileName) const
+{
+    return d->postCrashReport(Private::prepareCrashReport(dumpFileName, 1, d->uploadCompressionEnabled, thread()));
+}
+
+/*!
+    Reads the files of crash report \a dumpFileName and assembles the form data
+    for uploading it. This is thread-safe and does not involve \c this, so that it
+    can run on a worker thread. The form data gets moved to \a targetThread.
+*/
+CrashReport HockeyAppManager::Private::prepareCrashReport(const QString &dumpFileName, int occurrences,
+                                                          bool compressed, QThread *targetThread)
 {
     const auto commonFileName = dumpFileName.left(dumpFileName.length() - 3);
+    const auto bundleFileName = commonFileName + "kdh"_l1;
     const auto metaFileName = commonFileName + "dsc"_l1;
+    const auto logFileName = commonFileName + "log"_l1;
+    const auto qmlTraceFileName = commonFileName + "qst"_l1;
+    const auto breadcrumbFileName = commonFileName + "bcr"_l1;
     const QFileInfo dumpFileInfo{dumpFileName};
-    const auto crashId = dumpFileInfo.baseName();
-    QStringList crashFiles;
+    const auto encoding = compressed ? Compressed : Plain;
+
+    CrashReport report;
+    report.crashId = dumpFileInfo.baseName();
+
+    const auto sections = CrashBundle::readSections(bundleFileName);
+    const auto findSection = [&sections](CrashBundle::SectionType type) -> const CrashBundle::Section * {
+        const auto it = std::find_if(sections.cbegin(), sections.cend(), [type](const CrashBundle::Section &section) {
+            return section.type == type;
+        });
+
+        return it != sections.cend() ? &*it : nullptr;
+    };
+
+    if (QFile::exists(bundleFileName))
+        report.crashFiles << bundleFileName;
+
+    const auto logSection = findSection(CrashBundle::Log);
+
+    if (!logSection && !QFile::exists(logFileName))
+        recoverLogFile(commonFileName);
 
-    qCInfo(lcHockeyApp, "Uploading crash report %ls", qUtf16Printable(crashId));
     QScopedPointer<QHttpMultiPart> formData{new QHttpMultiPart{QHttpMultiPart::FormDataType}};
 
     {
-        QFile file{metaFileName};
-        if (!file.open(QFile::ReadOnly)) {
-            qCWarning(lcHockeyApp, "Could not open meta information file to upload crash %ls: %ls",
-                      qUtf16Printable(crashId), qUtf16Printable(file.errorString()));
-            return {};
+        QByteArray metaData;
+
+        if (const auto section = findSection(CrashBundle::MetaData)) {
+            CrashBundleSection device{bundleFileName, *section};
+
+            if (!device.open(QIODevice::ReadOnly)) {
+                qCWarning(lcHockeyApp, "Could not open crash bundle to upload crash %ls: %ls",
+                          qUtf16Printable(report.crashId), qUtf16Printable(device.errorString()));
+                return report;
+            }
+
+            metaData = device.readAll();
+
+            // a meta file might have been written in advance for the persistent log
+            if (QFile::exists(metaFileName))
+                report.crashFiles << metaFileName;
+        } else {
+            QFile file{metaFileName};
+            if (!file.open(QFile::ReadOnly)) {
+                qCWarning(lcHockeyApp, "Could not open meta information file to upload crash %ls: %ls",
+                          qUtf16Printable(report.crashId), qUtf16Printable(file.errorString()));
+                return report;
+            }
+
+            metaData = file.readAll();
+            report.crashFiles << file.fileName();
         }
 
-        auto metaData = file.readAll();
-        metaData.replace("@@CRASHID@@", crashId.toUtf8());
+        metaData.replace("@@CRASHID@@", report.crashId.toUtf8());
         metaData.replace("@@MINIDUMP_TIMESTAMP@@", dumpFileInfo.lastModified().toString(Qt::RFC2822Date).toLatin1());
 
+        // tell how many dropped repeats of this crash the report stands for
+        if (occurrences > 1) {
+            const auto headerEnd = metaData.indexOf("\n\n");
+
+            if (headerEnd >= 0)
+                metaData.insert(headerEnd + 1, "Occurrences: " + QByteArray::number(occurrences) + '\n');
+        }
+
         QHttpPart part;
-        part.setHeader(QNetworkRequest::ContentDispositionHeader, s_formDataHeaderMeta.arg(crashId));
+        part.setHeader(QNetworkRequest::ContentDispositionHeader, s_formDataHeaderMeta.arg(report.crashId));
         part.setHeader(QNetworkRequest::ContentTypeHeader, "text/plain"_l1);
         part.setBody(metaData);
         formData->append(part);
+    }
 
-        crashFiles << file.fileName();
+    if (!attachFile(formData.data(), "attachment0"_l1, dumpFileName, &report.crashFiles, Mandatory, encoding))
+        return report;
+
+    if (const auto section = findSection(CrashBundle::QmlTrace)) {
+        attachSection(formData.data(), "attachment1"_l1, QFileInfo{qmlTraceFileName}.fileName(),
+                      bundleFileName, *section, encoding);
+    } else {
+        attachFile(formData.data(), "attachment1"_l1, qmlTraceFileName, &report.crashFiles, Optional, encoding);
     }
 
-    if (!attachFile(formData.data(), "attachment0"_l1, dumpFileName, &crashFiles, Mandatory))
-        return {};
+    if (logSection) {
+        const auto uploadFileName = QFileInfo{logFileName}.fileName();
+        CrashBundleSection device{bundleFileName, *logSection};
+
+        if (isBinaryLog(&device))
+            attachSection(formData.data(), "attachment2"_l1, uploadFileName, bundleFileName, *logSection, encoding);
+        else
+            attachSection(formData.data(), "description"_l1, uploadFileName, bundleFileName, *logSection);
+    } else if (isBinaryLogFile(logFileName)) {
+        attachFile(formData.data(), "attachment2"_l1, logFileName, &report.crashFiles, Mandatory, encoding);
+    } else {
+        attachFile(formData.data(), "description"_l1, logFileName, &report.crashFiles, Mandatory);
+    }
+
+    if (const auto section = findSection(CrashBundle::Breadcrumbs)) {
+        attachSection(formData.data(), "attachment3"_l1, QFileInfo{breadcrumbFileName}.fileName(),
+                      bundleFileName, *section, encoding);
+    } else {
+        attachFile(formData.data(), "attachment3"_l1, breadcrumbFileName, &report.crashFiles, Optional, encoding);
+    }
+
+    // the network access manager and the reply will live in that thread
+    formData->moveToThread(targetThread);
+    report.formData = formData.take();
+
+    return report;
+}
+
+/*!
+    Starts a background job which prepares the crash report \a dumpFileName,
+    standing for \a occurrences crashes, for uploading by postCrashReport().
+*/
+QFuture<CrashReport> HockeyAppManager::Private::prepareCrashReportAsync(const QString &dumpFileName, int occurrences) const
+{
+    return QtConcurrent::run(&Private::prepareCrashReport, dumpFileName, occurrences, uploadCompressionEnabled, q->thread());
+}
 
-    attachFile(formData.data(), "attachment1"_l1, commonFileName + "qst"_l1, &crashFiles, Optional);
-    attachFile(formData.data(), "description"_l1, commonFileName + "log"_l1, &crashFiles, Mandatory);
+QNetworkReply *HockeyAppManager::Private::postCrashReport(const CrashReport &report)
+{
+    if (!report.formData)
+        return {};
 
-    QNetworkRequest request{QUrl{s_restUrlUploadCrashReport.arg(d->appId)}};
+    qCInfo(lcHockeyApp, "Uploading crash report %ls", qUtf16Printable(report.crashId));
+    QScopedPointer<QHttpMultiPart> formData{report.formData};
+    QNetworkRequest request{QUrl{s_restUrlUploadCrashReport.arg(appId)}};
 
     // Qt wraps the boundary token in quotation marks and HockeyApp service doesn't like that.
     request.setRawHeader("Content-Type", "multipart/form-data; boundary=" + formData->boundary());
 
-    const auto reply = d->networkAccessManager()->post(request, formData.data());
+    const auto reply = networkAccessManager()->post(request, formData.data());
     formData.take()->setParent(reply);
 
-    connect(reply, &QNetworkReply::finished, this, [reply, crashId, crashFiles] {
+    const auto crashId = report.crashId;
+    const auto crashFiles = report.crashFiles;
+
+    QObject::connect(reply, &QNetworkReply::finished, q, [this, reply, crashId, crashFiles] {
         if (reply->error() == QNetworkReply::NoError) {
             for (const auto &fileName: crashFiles)
                 QFile::remove(fileName);
+
+            crashSpool.scheduleRemoval(crashId);
         } else {
             qCWarning(lcHockeyApp, "Could not upload crash report %ls: %ls",
                       qUtf16Printable(crashId), qUtf16Printable(reply->errorString()));
@@ -504,6 +1757,8 @@ QNetworkReply *HockeyAppManager::uploadCrashDump(const QString &dumpFileName) co
         reply->deleteLater();
     });
 
+    emit q->crashDumpUploadStarted(crashId);
+
     return reply;
 }
 
@@ -511,6 +1766,8 @@ QNetworkReply *HockeyAppManager::uploadCrashDump(const QString &dumpFileName) co
     \fn void HockeyAppManager::findNewVersions()
 
     Query HockeyApp for available new versions of the application.
+
+    \sa setVersionCheckInterval()
 */
 
 void HockeyAppManager::findNewVersions()
@@ -540,68 +1797,49 @@ void HockeyAppManager::findNewVersions()
     QUrl url{s_restUrlListVersions.arg(d->appId)};
     url.setQuery(query);
 
-    const auto reply = d->networkAccessManager()->get(QNetworkRequest{url});
-
-    connect(reply, &QNetworkReply::finished, this, [this, reply, appInfo] {
-        reply->deleteLater();
-
-        if (reply->error() != QNetworkReply::NoError) {
-            qCWarning(lcHockeyApp, "Failed to query app versions: %ls %d",
-                      qUtf16Printable(reply->errorString()), reply->error());
-            return;
-        }
-
-        QJsonParseError parseError;
-        const auto versions = QJsonDocument::fromJson(reply->readAll(), &parseError).array();
-        if (parseError.error != QJsonParseError::NoError) {
-            qCWarning(lcHockeyApp, "Failed to query app versions: %ls",
-                      qUtf16Printable(parseError.errorString()));
-            return;
-        }
-
-        d->newVersions.clear();
-
+    d->versionChecker.check(d->networkAccessManager(), url, this, [this, appInfo](const QVector<VersionChecker::Version> &versions) {
         const auto appVersion = appInfo.versionCode ? QVersionNumber{appInfo.versionCode}
                                                     : QVersionNumber::fromString(appInfo.versionName);
         const auto actualPlatformVersion = QVersionNumber::fromString(appInfo.platformVersion);
+        const auto installTimestamp = QFileInfo{qApp->applicationFilePath()}.lastModified().toMSecsSinceEpoch();
 
-        for (const auto &value: versions) {
-            const auto entry = value.toObject();
-            const auto updateVersion = QVersionNumber::fromString(entry["version"_l1].toString());
-            const auto largerVersionCode = updateVersion > appVersion;
-
-            const auto packageTimestamp = qRound64(entry["timestamp"_l1].toDouble() * 1000);
-            const auto installTimestamp = QFileInfo{qApp->applicationFilePath()}.lastModified().toMSecsSinceEpoch();
-            const auto newerPackageFile = updateVersion == appVersion && packageTimestamp > installTimestamp;
+        // the versions are sorted already, only the QML facing list must be built
+        d->newVersions.clear();
 
-            const auto minimumPlatformVersion = QVersionNumber::fromString(entry["minimum_os_version"_l1].toString());
-            const auto requirementsMet = minimumPlatformVersion <= actualPlatformVersion;
+        for (const auto &entry: versions) {
+            const auto largerVersionCode = entry.version > appVersion;
+            const auto newerPackageFile = entry.version == appVersion && entry.timestamp > installTimestamp;
+            const auto requirementsMet = entry.minimumPlatformVersion <= actualPlatformVersion;
 
             if ((largerVersionCode || newerPackageFile) && requirementsMet) {
-                const auto version = entry["shortversion"_l1].toString();
-                const auto size = qRound64(entry["appsize"_l1].toDouble());
-                const auto notes = entry["notes"_l1].toString();
-                const auto mandatory = entry["mandatory"_l1].toBool();
-
-                d->newVersions += QVariant::fromValue(HockeyAppVersionInfo{version, packageTimestamp, size, notes, mandatory});
+                d->newVersions += QVariant::fromValue(HockeyAppVersionInfo{entry.versionName, entry.timestamp,
+                                                                           entry.size, entry.notes, entry.mandatory});
             }
         }
 
-        if (!d->newVersions.isEmpty()) {
-            std::sort(d->newVersions.begin(), d->newVersions.end(),
-                      [](const QVariant &lhsVariant, const QVariant &rhsVariant) {
-                const auto lhs = lhsVariant.value<HockeyAppVersionInfo>();
-                const auto rhs = rhsVariant.value<HockeyAppVersionInfo>();
+        if (!d->newVersions.isEmpty())
+            emit newVersionsFound(d->newVersions);
+    });
+}
 
-                if (QVersionNumber::fromString(lhs.versionName) > QVersionNumber::fromString(rhs.versionName))
-                    return true;
+/*!
+    \fn void HockeyAppManager::setVersionCheckInterval(int interval)
 
-                return lhs.timestamp > rhs.timestamp;
-            });
+    Sets the minimum \a interval in milliseconds between two requests of
+    findNewVersions(). Within this interval findNewVersions() reports the
+    versions received last time. The list of versions is cached on disk,
+    and only transferred again if it has changed. The default interval
+    is 15 minutes.
+*/
 
-            emit newVersionsFound(d->newVersions);
-        }
-    });
+void HockeyAppManager::setVersionCheckInterval(int interval)
+{
+    d->versionChecker.setMinimumRefreshInterval(interval);
+}
+
+int HockeyAppManager::versionCheckInterval() const
+{
+    return static_cast<int>(d->versionChecker.minimumRefreshInterval());
 }
 
 QUrl HockeyAppManager::installUrl()
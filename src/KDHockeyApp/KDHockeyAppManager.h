@@ -58,18 +58,83 @@ class HockeyAppManager : public QObject
     Q_PROPERTY(QVariantList newVersions READ newVersions NOTIFY newVersionsFound FINAL)
 
 public:
+    enum class Initialization { Immediate, Deferred };
+    Q_ENUM(Initialization)
+
+    enum class LogFormat { Text, Binary };
+    Q_ENUM(LogFormat)
+
+    enum class BreadcrumbType { Navigation, Network, UserAction, Lifecycle, Custom };
+    Q_ENUM(BreadcrumbType)
+
     explicit HockeyAppManager(const QString &appId, QObject *parent = {});
+    explicit HockeyAppManager(const QString &appId, Initialization initialization, QObject *parent = {});
     ~HockeyAppManager();
 
+    static void setCrashServerProgram(const QString &program);
+    static QString crashServerProgram();
+
+    static void setMiniDumpSizeLimit(qint64 limit);
+    static qint64 miniDumpSizeLimit();
+
+    static void setMiniDumpStackSanitizationEnabled(bool enabled);
+    static bool isMiniDumpStackSanitizationEnabled();
+
+    static void setMiniDumpPrincipalMapping(const void *address);
+    static const void *miniDumpPrincipalMapping();
+
+    static void setMicroDumpFallbackHandle(int handle);
+    static int microDumpFallbackHandle();
+
     void setNetworkAccessManager(QNetworkAccessManager *manager);
     QNetworkAccessManager *networkAccessManager() const;
 
     void setQmlEngine(QQmlEngine *engine);
     QQmlEngine *qmlEngine() const;
 
+    bool setLogCapacity(int capacity);
+    int logCapacity() const;
+
+    bool setLogCapacity(QtMsgType type, int capacity);
+    int logCapacity(QtMsgType type) const;
+
+    bool setLogMemoryBudget(int budget);
+    int logMemoryBudget() const;
+
+    bool setLogFormat(LogFormat format);
+    LogFormat logFormat() const;
+
+    void setPersistentLogEnabled(bool enabled);
+    bool isPersistentLogEnabled() const;
+
+    bool setCrashBundleEnabled(bool enabled);
+    bool isCrashBundleEnabled() const;
+
+    void addBreadcrumb(BreadcrumbType type, const char *message, int size = -1);
+
     QNetworkReply *uploadCrashDump(const QString &dumpFileName) const;
     void uploadCrashDumps() const;
 
+    void setCrashSpoolQuota(qint64 maximumSize, int maximumCount = 0);
+    qint64 crashSpoolMaximumSize() const;
+    int crashSpoolMaximumCount() const;
+
+    void setMaximumConcurrentUploads(int count);
+    int maximumConcurrentUploads() const;
+
+    void setDuplicateCrashLimit(int limit);
+    int duplicateCrashLimit() const;
+
+    void setSoftAssertReportLimit(int burst, int interval);
+    int softAssertReportBurst() const;
+    int softAssertReportInterval() const;
+
+    bool setUploadCompressionEnabled(bool enabled);
+    bool isUploadCompressionEnabled() const;
+
+    void setVersionCheckInterval(int interval);
+    int versionCheckInterval() const;
+
     Q_INVOKABLE void findNewVersions();
     Q_INVOKABLE QUrl installUrl();
 
@@ -78,6 +143,11 @@ public:
 signals:
     void newVersionsFound(const QVariantList &newVersions);
 
+    void crashDumpUploadStarted(const QString &crashId);
+    void crashDumpUploaded(const QString &crashId);
+    void crashDumpUploadFailed(const QString &crashId, const QString &errorString);
+    void crashDumpUploadProgress(int completed, int total);
+
 private:
     struct AppInfo
     {
@@ -25,6 +25,7 @@
 #include "KDHockeyAppManager_p.h"
 
 #include "KDHockeyAppLiterals_p.h"
+#include "KDHockeyAppMiniDumpPolicy_p.h"
 #include "KDHockeyAppSoftAssert_p.h"
 
 #ifdef __i386__
@@ -38,6 +39,7 @@ typedef struct user_fxsr_struct user_fpxregs_struct;
 
 #include <QAndroidJniEnvironment>
 #include <QCryptographicHash>
+#include <QFile>
 #include <QLoggingCategory>
 #include <QStandardPaths>
 #include <QtAndroid>
@@ -108,8 +110,9 @@ bool isEmpty(QAndroidJniObject str)
 class PlatformData
 {
 public:
-    explicit PlatformData(const QString &path, ExceptionHandler::MinidumpCallback callback, void *context)
-        : eh{MinidumpDescriptor{path.toStdString()}, nullptr, callback, context, true, -1}
+    explicit PlatformData(const QString &path, ExceptionHandler::FilterCallback filter,
+                          ExceptionHandler::MinidumpCallback callback, void *context)
+        : eh{MiniDumpPolicy::makeDescriptor(path), filter, callback, context, true, -1}
     {}
 
     const ExceptionHandler eh;
@@ -122,11 +125,17 @@ class HockeyAppManager::PlatformPrivate : public PlatformData, public Private
 {
 public:
     explicit PlatformPrivate(const QString &appId, HockeyAppManager *q)
-        : PlatformData{dataDirPath(), &PlatformPrivate::onException, this}
+        : PlatformData{dataDirPath(), &PlatformPrivate::onFilter, &PlatformPrivate::onException, this}
         , Private{appId, q}
     {}
 
 private:
+    static bool onFilter(void *context)
+    {
+        // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
+        return !static_cast<const PlatformPrivate *>(context)->crashSpool.isFull();
+    }
+
     static bool onException(const MinidumpDescriptor &, void *context, bool succeeded)
     {
         // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
@@ -188,6 +197,24 @@ std::string HockeyAppManager::Private::nextMiniDumpFileName() const
     return static_cast<const PlatformPrivate *>(this)->eh.minidump_descriptor().path();
 }
 
+QString HockeyAppManager::Private::writeMiniDumpSnapshot(const QString &dirPath) const
+{
+    QString dumpFileName;
+
+    // A handler of our own, which doesn't touch the crash file names of the installed handler.
+    // Its filter leaves crashes that happen meanwhile to the installed handler.
+    ExceptionHandler eh{MiniDumpPolicy::makeDescriptor(dirPath), [](void *) { return false; },
+                        [](const MinidumpDescriptor &descriptor, void *context, bool succeeded) {
+        if (succeeded)
+            *static_cast<QString *>(context) = QFile::decodeName(descriptor.path());
+
+        return succeeded;
+    }, &dumpFileName, false, -1};
+
+    eh.WriteMinidump();
+    return dumpFileName;
+}
+
 QString HockeyAppManager::Private::requestParameterDeviceId()
 {
     return "udid"_l1;
@@ -50,6 +50,11 @@ std::string HockeyAppManager::Private::nextMiniDumpFileName() const
     return {};
 }
 
+QString HockeyAppManager::Private::writeMiniDumpSnapshot(const QString &) const
+{
+    return {};
+}
+
 QString HockeyAppManager::Private::requestParameterDeviceId()
 {
     return "udid"_l1;
@@ -79,8 +79,9 @@ QString appendOrganizationAndApplicationName(QString &&path)
 class PlatformData
 {
 public:
-    explicit PlatformData(const QString &path, ExceptionHandler::MinidumpCallback callback, void *context)
-        : eh{path.toStdString(), nullptr, callback, context, true, nullptr}
+    explicit PlatformData(const QString &path, ExceptionHandler::FilterCallback filter,
+                          ExceptionHandler::MinidumpCallback callback, void *context)
+        : eh{path.toStdString(), filter, callback, context, true, nullptr}
     {}
 
     const ExceptionHandler eh;
@@ -93,11 +94,17 @@ class HockeyAppManager::PlatformPrivate : public PlatformData, public Private
 {
 public:
     explicit PlatformPrivate(const QString &appId, HockeyAppManager *q)
-        : PlatformData{dataDirPath(), &PlatformPrivate::onException, this}
+        : PlatformData{dataDirPath(), &PlatformPrivate::onFilter, &PlatformPrivate::onException, this}
         , Private{appId, q}
     {}
 
 private:
+    static bool onFilter(void *context)
+    {
+        // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
+        return !static_cast<const PlatformPrivate *>(context)->crashSpool.isFull();
+    }
+
     static bool onException(const char *, const char *, void *context, bool succeeded)
     {
         // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
@@ -136,6 +143,11 @@ std::string HockeyAppManager::Private::nextMiniDumpFileName() const
     return static_cast<const PlatformPrivate *>(this)->eh.next_minidump_path();
 }
 
+QString HockeyAppManager::Private::writeMiniDumpSnapshot(const QString &) const
+{
+    return {};
+}
+
 QString HockeyAppManager::Private::requestParameterDeviceId()
 {
     return "uuid"_l1;
@@ -25,16 +25,30 @@
 #include "KDHockeyAppManager_p.h"
 
 #include "KDHockeyAppLiterals_p.h"
+#include "KDHockeyAppMiniDumpPolicy_p.h"
 #include "KDHockeyAppSoftAssert_p.h"
 
+#include <client/linux/crash_generation/crash_generation_server.h>
 #include <client/linux/handler/exception_handler.h>
 
+#include <QCoreApplication>
 #include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
 #include <QLoggingCategory>
+#include <QProcess>
 #include <QStandardPaths>
 
+#include <sys/prctl.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <memory>
+
 namespace KDHockeyApp {
 
+using google_breakpad::CrashGenerationServer;
 using google_breakpad::ExceptionHandler;
 using google_breakpad::MinidumpDescriptor;
 
@@ -42,14 +56,149 @@ Q_DECLARE_LOGGING_CATEGORY(lcHockeyApp)
 
 namespace {
 
+#ifndef PR_SET_PTRACER
+#define PR_SET_PTRACER 0x59616d61
+#endif
+
+// The crash server's socket, process id and dump directory are passed to child processes
+// via these environment variables. Clients register the file name they expect for their
+// minidump as symbolic link named after their process id in the dump directory.
+constexpr char s_crashServerFdVariable[] = "KDHOCKEYAPP_CRASH_SERVER_FD";
+constexpr char s_crashServerPidVariable[] = "KDHOCKEYAPP_CRASH_SERVER_PID";
+constexpr char s_crashServerDirVariable[] = "KDHOCKEYAPP_CRASH_SERVER_DIR";
+
+struct CrashServerConnection
+{
+    int fd = -1;
+    QString dumpDirPath;
+};
+
+CrashServerConnection attachCrashServer()
+{
+    bool valid = false;
+    const auto fd = qEnvironmentVariableIntValue(s_crashServerFdVariable, &valid);
+
+    if (!valid || fcntl(fd, F_GETFD) == -1) {
+        qCWarning(lcHockeyApp, "Ignoring invalid crash server socket");
+        return {};
+    }
+
+    // the crash server must be permitted to ptrace us, even if it isn't our ancestor
+    if (const auto pid = qEnvironmentVariableIntValue(s_crashServerPidVariable))
+        prctl(PR_SET_PTRACER, pid, 0, 0, 0);
+
+    return {fd, QFile::decodeName(qgetenv(s_crashServerDirVariable))};
+}
+
+CrashServerConnection launchCrashServer(const QString &program, const QString &dumpDirPath)
+{
+    int serverFd, clientFd;
+
+    if (!CrashGenerationServer::CreateReportChannel(&serverFd, &clientFd)) {
+        qCWarning(lcHockeyApp, "Could not create the crash server socket");
+        return {};
+    }
+
+    if (!QFileInfo::exists(dumpDirPath))
+        QDir::current().mkpath(dumpDirPath);
+
+    // Only the server end must be inherited by the crash server. It would never
+    // notice that its last client is gone if it kept a copy of the client end.
+    fcntl(serverFd, F_SETFD, 0);
+    fcntl(clientFd, F_SETFD, FD_CLOEXEC);
+
+    const QStringList arguments = {
+        "--socket"_l1, QString::number(serverFd),
+        "--dump-path"_l1, dumpDirPath
+    };
+
+    qint64 pid = 0;
+    const auto started = QProcess::startDetached(program, arguments, {}, &pid);
+
+    // our worker processes shall inherit the client end to share this crash server
+    close(serverFd);
+    fcntl(clientFd, F_SETFD, 0);
+
+    if (!started) {
+        qCWarning(lcHockeyApp, "Could not launch the crash server %ls", qUtf16Printable(program));
+        close(clientFd);
+        return {};
+    }
+
+    prctl(PR_SET_PTRACER, pid, 0, 0, 0);
+
+    qputenv(s_crashServerFdVariable, QByteArray::number(clientFd));
+    qputenv(s_crashServerPidVariable, QByteArray::number(pid));
+    qputenv(s_crashServerDirVariable, QFile::encodeName(dumpDirPath));
+
+    return {clientFd, dumpDirPath};
+}
+
+CrashServerConnection connectCrashServer(const QString &dumpDirPath)
+{
+    if (qEnvironmentVariableIsSet(s_crashServerFdVariable))
+        return attachCrashServer();
+
+    const auto program = HockeyAppManager::crashServerProgram();
+
+    if (!program.isEmpty())
+        return launchCrashServer(program, dumpDirPath);
+
+    return {};
+}
+
+std::string makeMicroDumpProductInfo()
+{
+    return (QCoreApplication::applicationName() + ':'_l1 + QCoreApplication::applicationVersion()).toStdString();
+}
+
+std::unique_ptr<ExceptionHandler> createMicroDumpHandler(const std::string &productInfo,
+                                                         ExceptionHandler::FilterCallback filter,
+                                                         void *context)
+{
+    if (HockeyAppManager::microDumpFallbackHandle() < 0)
+        return {};
+
+    MinidumpDescriptor descriptor{MinidumpDescriptor::kMicrodumpOnConsole};
+    descriptor.microdump_extra_info()->product_info = productInfo.c_str();
+    MiniDumpPolicy::apply(&descriptor);
+
+    // Breakpad tries its handlers in reverse order of creation, this one must be created first
+    // to only get called when the regular handler declined, or failed writing the minidump.
+    return std::make_unique<ExceptionHandler>(descriptor, filter, nullptr, context, true, -1);
+}
+
 class PlatformData
 {
 public:
-    explicit PlatformData(const QString &path, ExceptionHandler::MinidumpCallback callback, void *context)
-        : eh{MinidumpDescriptor{path.toStdString()}, nullptr, callback, context, true, -1}
-    {}
+    explicit PlatformData(const QString &path, ExceptionHandler::FilterCallback filter,
+                          ExceptionHandler::MinidumpCallback callback,
+                          ExceptionHandler::HandlerCallback crashHandler,
+                          ExceptionHandler::FilterCallback microDumpFilter, void *context)
+        : crashServer{connectCrashServer(path)}
+        , dumpDirectory{QFile::encodeName(path).toStdString()}
+        , microDumpProductInfo{makeMicroDumpProductInfo()}
+        , microDumpHandler{createMicroDumpHandler(microDumpProductInfo, microDumpFilter, context)}
+        , eh{MiniDumpPolicy::makeDescriptor(path), filter, callback, context, true, crashServer.fd}
+    {
+        if (eh.IsOutOfProcess()) {
+            // The crash server picks the minidump's file name, but our crash files
+            // are named after the minidump. Therefore pick a name now, which gets
+            // registered with the crash server later.
+            MinidumpDescriptor descriptor{path.toStdString()};
+            descriptor.UpdatePath();
+            eh.set_minidump_descriptor(descriptor);
+
+            // the minidump callback isn't called in out-of-process mode
+            eh.set_crash_handler(crashHandler);
+        }
+    }
 
-    const ExceptionHandler eh;
+    const CrashServerConnection crashServer;
+    const std::string dumpDirectory;
+    const std::string microDumpProductInfo;
+    const std::unique_ptr<ExceptionHandler> microDumpHandler;
+    ExceptionHandler eh;
 };
 
 } // namespace
@@ -59,15 +208,78 @@ class HockeyAppManager::PlatformPrivate : public PlatformData, public Private
 {
 public:
     explicit PlatformPrivate(const QString &appId, HockeyAppManager *q)
-        : PlatformData{dataDirPath(), &PlatformPrivate::onException, this}
+        : PlatformData{dataDirPath(), &PlatformPrivate::onFilter, &PlatformPrivate::onException,
+                       &PlatformPrivate::onCrash, &PlatformPrivate::onMicroDumpFilter, this}
         , Private{appId, q}
-    {}
+    {
+        if (eh.IsOutOfProcess() && !crashServer.dumpDirPath.isEmpty())
+            registerWithCrashServer();
+    }
+
+    ~PlatformPrivate()
+    {
+        if (eh.IsOutOfProcess() && !crashServer.dumpDirPath.isEmpty())
+            QFile::remove(crashServerRegistration());
+    }
 
 private:
+    QString crashServerRegistration() const
+    {
+        return QDir{crashServer.dumpDirPath}.filePath(QString::number(QCoreApplication::applicationPid()) + ".client"_l1);
+    }
+
+    void registerWithCrashServer() const
+    {
+        const auto registration = crashServerRegistration();
+        const auto dumpFileName = QString::fromStdString(crashFileTemplate);
+
+        QFile::remove(registration); // left behind by some previous process with the same pid
+
+        if (!QFile::link(dumpFileName, registration))
+            qCWarning(lcHockeyApp, "Could not register with the crash server: %ls", qUtf16Printable(registration));
+    }
+
+    static bool onFilter(void *context)
+    {
+        // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
+        // A filter declining the crash also suppresses onCrash(), so that the crash server would not
+        // find our registration. Crash servers keep their own spool, the quota only covers our minidumps.
+        const auto that = static_cast<const PlatformPrivate *>(context);
+        return (that->eh.IsOutOfProcess() || !that->crashSpool.isFull()) && access(that->dumpDirectory.c_str(), W_OK) == 0;
+    }
+
+    static bool onMicroDumpFilter(void *)
+    {
+        // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
+        // Breakpad writes microdumps to standard error, redirect them if requested.
+        const auto handle = HockeyAppManager::microDumpFallbackHandle();
+
+        if (handle != STDERR_FILENO)
+            dup2(handle, STDERR_FILENO);
+
+        return true;
+    }
+
     static bool onException(const MinidumpDescriptor &, void *context, bool succeeded)
     {
         // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
-        return static_cast<const PlatformPrivate *>(context)->writeCrashReport(succeeded);
+        // The result tells Breakpad whether the minidump got written, returning false makes it try
+        // the microdump fallback. Failing to write our other crash files is no reason for that.
+        if (!static_cast<const PlatformPrivate *>(context)->writeCrashReport(succeeded) && succeeded) {
+            static const char message[] = "KDHockeyApp: Could not write all crash files, the crash report is incomplete\n";
+            static_cast<void>(!write(STDERR_FILENO, message, sizeof message - 1));
+        }
+
+        return succeeded;
+    }
+
+    static bool onCrash(const void *, size_t, void *context)
+    {
+        // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
+        // Our crash files are written before the crash server writes the minidump. Returning
+        // false lets breakpad continue with requesting the minidump from the crash server.
+        static_cast<const PlatformPrivate *>(context)->writeCrashReport(true);
+        return false;
     }
 };
 
@@ -90,6 +302,24 @@ std::string HockeyAppManager::Private::nextMiniDumpFileName() const
     return static_cast<const PlatformPrivate *>(this)->eh.minidump_descriptor().path();
 }
 
+QString HockeyAppManager::Private::writeMiniDumpSnapshot(const QString &dirPath) const
+{
+    QString dumpFileName;
+
+    // A handler of our own, which doesn't touch the crash file names of the installed handler.
+    // Its filter leaves crashes that happen meanwhile to the installed handler.
+    ExceptionHandler eh{MiniDumpPolicy::makeDescriptor(dirPath), [](void *) { return false; },
+                        [](const MinidumpDescriptor &descriptor, void *context, bool succeeded) {
+        if (succeeded)
+            *static_cast<QString *>(context) = QFile::decodeName(descriptor.path());
+
+        return succeeded;
+    }, &dumpFileName, false, -1};
+
+    eh.WriteMinidump();
+    return dumpFileName;
+}
+
 QString HockeyAppManager::Private::requestParameterDeviceId()
 {
     return "udid"_l1;
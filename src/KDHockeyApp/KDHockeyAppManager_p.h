@@ -26,11 +26,19 @@
 #define KDHOCKEYAPPMANAGER_P_H
 
 #include "KDHockeyAppManager.h"
+#include "KDHockeyAppBreadcrumbRing_p.h"
+#include "KDHockeyAppCrashBundle_p.h"
+#include "KDHockeyAppCrashSignature_p.h"
+#include "KDHockeyAppCrashSpool_p.h"
+#include "KDHockeyAppQmlStackTrace_p.h"
+#include "KDHockeyAppUploadQueue_p.h"
+#include "KDHockeyAppVersionChecker_p.h"
 
-#include <QContiguousCache>
 #include <QDir>
 #include <QPointer>
 
+#include <atomic>
+
 namespace KDHockeyApp {
 
 class HockeyAppManager::Private
@@ -47,35 +55,71 @@ public:
     static Private *create(const QString &appId, HockeyAppManager *q);
 
     bool writeCrashReport(bool miniDumpWritten) const;
-    bool writeLogFile(const QContiguousCache<char> &logBuffer) const;
+    bool writeCrashBundle() const;
+    bool writeLogFile() const;
+    bool writeLogData(int fd) const;
+    bool writeBreadcrumbFile() const;
     bool writeMetaFile() const;
+    bool writeMetaData(int fd) const;
     bool writeQmlTrace() const;
+    bool writeSoftAssertReport(const char *file, int line, const char *expression, int occurrences);
+    QString writeMiniDumpSnapshot(const QString &dirPath) const;
+    const char *qmlStackTrace() const;
+
+    static bool recoverLogFile(const QString &commonFileName);
+    static void removeOrphanedCrashData(const QString &ownCommonFileName);
 
     static QDir cacheLocation();
     static QString dataDirPath();
     static AppInfo makeAppInfo();
+    static AppInfo makeBasicAppInfo();
     static void fillAppInfo(AppInfo *appInfo);
+    void collectAppInfo();
+    const QByteArray &metaData() const { return *m_metaData.load(std::memory_order_acquire); }
+
     std::string makeCrashFileName(const std::string &suffix) const;
     std::string nextMiniDumpFileName() const;
 
     static QString requestParameterDeviceId();
     static bool installedFromMarket();
 
+    static CrashReport prepareCrashReport(const QString &dumpFileName, int occurrences,
+                                          bool compressed, QThread *targetThread);
+    QFuture<CrashReport> prepareCrashReportAsync(const QString &dumpFileName, int occurrences) const;
+    QNetworkReply *postCrashReport(const CrashReport &report);
+
     void setNetworkAccessManager(QNetworkAccessManager *network);
     QNetworkAccessManager *networkAccessManager();
 
     const QString appId;
-    const QByteArray metaData{makeAppInfo().toByteArray()};
+    const std::string crashFileTemplate{nextMiniDumpFileName()};
     const std::string logFileName{makeCrashFileName("log")};
     const std::string metaFileName{makeCrashFileName("dsc")};
     const std::string qmlTraceFileName{makeCrashFileName("qst")};
+    const std::string breadcrumbFileName{makeCrashFileName("bcr")};
 
+    VersionChecker versionChecker{cacheLocation().filePath(QStringLiteral("versions.json"))};
     QVariantList newVersions;
-    QPointer<QQmlEngine> qmlEngine;
+    QmlStackTrace qmlTrace;
+    bool uploadCompressionEnabled = false;
+    CrashBundle crashBundle;
+    BreadcrumbRing breadcrumbs;
+    CrashSpool crashSpool{dataDirPath()};
+    CrashSignatureIndex crashSignatures{QDir{dataDirPath()}.filePath(QStringLiteral("signatures.ini"))};
     HockeyAppManager *const q;
+    UploadQueue uploadQueue{q, &crashSignatures, &crashSpool, [this](const QString &dumpFileName, int occurrences) {
+        return prepareCrashReportAsync(dumpFileName, occurrences);
+    }, [this](const CrashReport &report) {
+        return postCrashReport(report);
+    }};
 
 private:
     QPointer<QNetworkAccessManager> m_network;
+
+    // the meta data might get completed while crashing, therefore it is published atomically
+    const QByteArray m_basicMetaData{makeBasicAppInfo().toByteArray()};
+    QByteArray m_completeMetaData;
+    std::atomic<const QByteArray *> m_metaData{&m_basicMetaData};
 };
 
 } // namespace KDHockeyApp
@@ -41,12 +41,21 @@ namespace {
 class PlatformData
 {
 public:
-    explicit PlatformData(const QString &path, ExceptionHandler::MinidumpCallback callback, void *context)
-        : eh{path.toStdWString(), NoFilter, callback, context, ExceptionHandler::HANDLER_ALL,
-             MiniDumpNormal, NoPipeName, NoClientInfo}
+    explicit PlatformData(const QString &path, ExceptionHandler::FilterCallback filter,
+                          ExceptionHandler::MinidumpCallback callback, void *context)
+        : eh{path.toStdWString(), filter, callback, context, ExceptionHandler::HANDLER_ALL,
+             miniDumpType(), NoPipeName, NoClientInfo}
     {}
 
-    constexpr static ExceptionHandler::FilterCallback NoFilter = nullptr;
+    static MINIDUMP_TYPE miniDumpType()
+    {
+        // the stack filter of DbgHelp keeps only the values needed for unwinding
+        if (HockeyAppManager::isMiniDumpStackSanitizationEnabled())
+            return static_cast<MINIDUMP_TYPE>(MiniDumpNormal | MiniDumpFilterMemory);
+
+        return MiniDumpNormal;
+    }
+
     constexpr static const wchar_t *NoPipeName = nullptr;
     constexpr static const CustomClientInfo *NoClientInfo = nullptr;
 
@@ -60,11 +69,17 @@ class HockeyAppManager::PlatformPrivate : public PlatformData, public Private
 {
 public:
     explicit PlatformPrivate(const QString &appId, HockeyAppManager *q)
-        : PlatformData{dataDirPath(), &PlatformPrivate::onException, this}
+        : PlatformData{dataDirPath(), &PlatformPrivate::onFilter, &PlatformPrivate::onException, this}
         , Private{appId, q}
     {}
 
 private:
+    static bool onFilter(void *context, EXCEPTION_POINTERS *, MDRawAssertionInfo *)
+    {
+        // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
+        return !static_cast<const PlatformPrivate *>(context)->crashSpool.isFull();
+    }
+
     static bool onException(const wchar_t *, const wchar_t *, void *context,
                             EXCEPTION_POINTERS *, MDRawAssertionInfo *, bool succeeded)
     {
@@ -93,6 +108,24 @@ std::string HockeyAppManager::Private::nextMiniDumpFileName() const
     return QString::fromStdWString(fileName).toStdString();
 }
 
+QString HockeyAppManager::Private::writeMiniDumpSnapshot(const QString &dirPath) const
+{
+    QString dumpFileName;
+
+    ExceptionHandler::WriteMinidump(dirPath.toStdWString(),
+                                    [](const wchar_t *dumpPath, const wchar_t *miniDumpId, void *context,
+                                       EXCEPTION_POINTERS *, MDRawAssertionInfo *, bool succeeded) {
+        if (succeeded) {
+            *static_cast<QString *>(context) = QDir{QString::fromWCharArray(dumpPath)}.filePath(
+                        QString::fromWCharArray(miniDumpId) + ".dmp"_l1);
+        }
+
+        return succeeded;
+    }, &dumpFileName, PlatformData::miniDumpType());
+
+    return dumpFileName;
+}
+
 QString HockeyAppManager::Private::requestParameterDeviceId()
 {
     return "udid"_l1;
@@ -0,0 +1,51 @@
+//
+// Copyright (C) 2017 Klaralvdalens Datakonsult AB, a KDAB Group company, info@kdab.com.
+// All rights reserved.
+//
+// This file is part of the KD HockeyApp library.
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of either:
+//
+//   The GNU Lesser General Public License version 2.1 and version 3
+//   as published by the Free Software Foundation and appearing in the
+//   file LICENSE.LGPL.txt included.
+//
+// Or:
+//
+//   The Mozilla Public License Version 2.0 as published by the Mozilla
+//   Foundation and appearing in the file LICENSE.MPL2.txt included.
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Contact info@kdab.com if any conditions of this licensing is not clear to you.
+//
+
+#include "KDHockeyAppMiniDumpPolicy_p.h"
+
+#include "KDHockeyAppManager.h"
+
+namespace KDHockeyApp {
+
+using google_breakpad::MinidumpDescriptor;
+
+void MiniDumpPolicy::apply(MinidumpDescriptor *descriptor)
+{
+    descriptor->set_size_limit(HockeyAppManager::miniDumpSizeLimit());
+    descriptor->set_sanitize_stacks(HockeyAppManager::isMiniDumpStackSanitizationEnabled());
+
+    if (const auto address = HockeyAppManager::miniDumpPrincipalMapping()) {
+        descriptor->set_address_within_principal_mapping(reinterpret_cast<uintptr_t>(address));
+        descriptor->set_skip_dump_if_principal_mapping_not_referenced(true);
+    }
+}
+
+MinidumpDescriptor MiniDumpPolicy::makeDescriptor(const QString &path)
+{
+    MinidumpDescriptor descriptor{path.toStdString()};
+    apply(&descriptor);
+    return descriptor;
+}
+
+} // namespace KDHockeyApp
@@ -0,0 +1,51 @@
+//
+// Copyright (C) 2017 Klaralvdalens Datakonsult AB, a KDAB Group company, info@kdab.com.
+// All rights reserved.
+//
+// This file is part of the KD HockeyApp library.
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of either:
+//
+//   The GNU Lesser General Public License version 2.1 and version 3
+//   as published by the Free Software Foundation and appearing in the
+//   file LICENSE.LGPL.txt included.
+//
+// Or:
+//
+//   The Mozilla Public License Version 2.0 as published by the Mozilla
+//   Foundation and appearing in the file LICENSE.MPL2.txt included.
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Contact info@kdab.com if any conditions of this licensing is not clear to you.
+//
+
+#ifndef KDHOCKEYAPPMINIDUMPPOLICY_P_H
+#define KDHOCKEYAPPMINIDUMPPOLICY_P_H
+
+#include <client/linux/handler/minidump_descriptor.h>
+
+#include <QString>
+
+namespace KDHockeyApp {
+
+/**
+ * Applies the minidump settings of HockeyAppManager to the descriptors of Breakpad's
+ * Linux client, which is shared by the Linux and the Android backend: The size limit,
+ * stack sanitization, and the principal mapping filter.
+ *
+ * The settings must be final before the first manager is constructed, as descriptors
+ * get copied into the exception handlers.
+ */
+class MiniDumpPolicy
+{
+public:
+    static void apply(google_breakpad::MinidumpDescriptor *descriptor);
+    static google_breakpad::MinidumpDescriptor makeDescriptor(const QString &path);
+};
+
+} // namespace KDHockeyApp
+
+#endif // KDHOCKEYAPPMINIDUMPPOLICY_P_H
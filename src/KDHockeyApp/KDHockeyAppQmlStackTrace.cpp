@@ -0,0 +1,222 @@
+//
+// Copyright (C) 2017 Klaralvdalens Datakonsult AB, a KDAB Group company, info@kdab.com.
+// All rights reserved.
+//
+// This file is part of the KD HockeyApp library.
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of either:
+//
+//   The GNU Lesser General Public License version 2.1 and version 3
+//   as published by the Free Software Foundation and appearing in the
+//   file LICENSE.LGPL.txt included.
+//
+// Or:
+//
+//   The Mozilla Public License Version 2.0 as published by the Mozilla
+//   Foundation and appearing in the file LICENSE.MPL2.txt included.
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Contact info@kdab.com if any conditions of this licensing is not clear to you.
+//
+
+
+#include "KDHockeyAppQmlStackTrace_p.h"
+
+#include "KDHockeyAppConfig.h"
+
+#include <QString>
+
+#ifdef KDHOCKEYAPP_QMLSUPPORT_ENABLED
+#include <private/qqmlengine_p.h>
+#include <private/qv4engine_p.h>
+
+extern "C" Q_QML_EXPORT char *qt_v4StackTrace(void *);
+#endif
+
+namespace KDHockeyApp {
+
+namespace {
+
+#ifdef KDHOCKEYAPP_QMLSUPPORT_ENABLED
+
+constexpr int s_maximumFrameCount = 32;
+constexpr int s_maximumChainLength = 1024; // stops at corrupted, circular frame chains
+
+class TraceWriter
+{
+public:
+    explicit TraceWriter(char *buffer, int capacity)
+        : m_data{buffer}
+        , m_capacity{capacity - 1} // for the terminating null
+    {}
+
+    void append(char ch)
+    {
+        if (m_size < m_capacity)
+            m_data[m_size++] = ch;
+    }
+
+    void append(const char *text)
+    {
+        while (*text)
+            append(*text++);
+    }
+
+    void append(int number)
+    {
+        char digits[10];
+        auto count = 0;
+        auto value = static_cast<unsigned>(number);
+
+        if (number < 0) {
+            append('-');
+            value = 0u - value;
+        }
+
+        do {
+            digits[count++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value > 0);
+
+        while (count > 0)
+            append(digits[--count]);
+    }
+
+    void append(const QString &text)
+    {
+        // constData() is used because utf16() might detach from raw data
+        const auto begin = text.constData();
+        const auto end = begin + text.size();
+
+        for (auto it = begin; it != end; ++it) {
+            uint codePoint = it->unicode();
+
+            if (it->isHighSurrogate() && it + 1 != end && it[1].isLowSurrogate()) {
+                codePoint = QChar::surrogateToUcs4(it[0], it[1]);
+                ++it;
+            }
+
+            if (codePoint < 0x80) {
+                append(static_cast<char>(codePoint));
+            } else if (codePoint < 0x800) {
+                append(static_cast<char>(0xc0 | codePoint >> 6));
+                append(static_cast<char>(0x80 | (codePoint & 0x3f)));
+            } else if (codePoint < 0x10000) {
+                append(static_cast<char>(0xe0 | codePoint >> 12));
+                append(static_cast<char>(0x80 | (codePoint >> 6 & 0x3f)));
+                append(static_cast<char>(0x80 | (codePoint & 0x3f)));
+            } else {
+                append(static_cast<char>(0xf0 | codePoint >> 18));
+                append(static_cast<char>(0x80 | (codePoint >> 12 & 0x3f)));
+                append(static_cast<char>(0x80 | (codePoint >> 6 & 0x3f)));
+                append(static_cast<char>(0x80 | (codePoint & 0x3f)));
+            }
+        }
+    }
+
+    const char *finish()
+    {
+        m_data[m_size] = '\0';
+        return m_data;
+    }
+
+private:
+    char *const m_data;
+    const int m_capacity;
+    int m_size = 0;
+};
+
+template<class Engine> auto engineContext(const Engine *engine) -> decltype(engine->currentContext())
+{
+    return engine->currentContext();
+}
+
+template<class Engine> auto engineContext(const Engine *engine, ...) -> decltype(engine->currentContext)
+{
+    return engine->currentContext;
+}
+
+// same format as qt_v4StackTrace(), so that the reports look alike for all Qt versions
+template<class Engine> auto writeFrames(const Engine *engine, TraceWriter *writer) -> decltype(engine->currentStackFrame, bool())
+{
+    auto level = 0;
+    auto chainLength = 0;
+    writer->append("stack=[");
+
+    // native frames don't count as level, therefore the chain needs a bound of its own
+    for (auto frame = engine->currentStackFrame; frame && level < s_maximumFrameCount
+         && chainLength < s_maximumChainLength; frame = frame->parent, ++chainLength) {
+        if (!frame->v4Function)
+            continue; // native code
+
+        if (level > 0)
+            writer->append(',');
+
+        writer->append("frame={level=\"");
+        writer->append(level++);
+        writer->append("\",func=\"");
+        writer->append(frame->function());
+        writer->append("\",file=\"");
+        writer->append(frame->source());
+        writer->append("\",line=\"");
+        writer->append(frame->lineNumber());
+        writer->append("\",language=\"js\"}");
+    }
+
+    writer->append(']');
+    return true;
+}
+
+template<class Engine> bool writeFrames(const Engine *, TraceWriter *, ...)
+{
+    return false; // this version of Qt has no chain of stack frames
+}
+
+#endif // KDHOCKEYAPP_QMLSUPPORT_ENABLED
+
+} // namespace
+
+QmlStackTrace::QmlStackTrace(int capacity)
+    : m_buffer{new char[capacity]()} // value initialization touches the buffer's pages in advance
+    , m_capacity{capacity}
+{}
+
+#ifdef KDHOCKEYAPP_QMLSUPPORT_ENABLED
+
+void QmlStackTrace::setEngine(QQmlEngine *engine)
+{
+    m_engine = engine;
+}
+
+QQmlEngine *QmlStackTrace::engine() const
+{
+    return m_engine;
+}
+
+#endif // KDHOCKEYAPP_QMLSUPPORT_ENABLED
+
+const char *QmlStackTrace::capture() const
+{
+    // NOTICE: This context is compromised. Complex operations, allocations must be avoided!
+
+#ifdef KDHOCKEYAPP_QMLSUPPORT_ENABLED
+    const auto engine = m_engine ? QQmlEnginePrivate::getV4Engine(m_engine.data()) : nullptr;
+
+    if (!engine)
+        return nullptr;
+
+    TraceWriter writer{m_buffer.get(), m_capacity};
+
+    if (writeFrames(engine, &writer))
+        return writer.finish();
+
+    return qt_v4StackTrace(engineContext(engine)); // FIXME: we should not allocate memory here!
+#else // !KDHOCKEYAPP_QMLSUPPORT_ENABLED
+    return nullptr;
+#endif // !KDHOCKEYAPP_QMLSUPPORT_ENABLED
+}
+
+} // namespace KDHockeyApp
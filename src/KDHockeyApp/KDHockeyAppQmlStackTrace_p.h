@@ -0,0 +1,70 @@
+//
+// Copyright (C) 2017 Klaralvdalens Datakonsult AB, a KDAB Group company, info@kdab.com.
+// All rights reserved.
+//
+// This file is part of the KD HockeyApp library.
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of either:
+//
+//   The GNU Lesser General Public License version 2.1 and version 3
+//   as published by the Free Software Foundation and appearing in the
+//   file LICENSE.LGPL.txt included.
+//
+// Or:
+//
+//   The Mozilla Public License Version 2.0 as published by the Mozilla
+//   Foundation and appearing in the file LICENSE.MPL2.txt included.
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Contact info@kdab.com if any conditions of this licensing is not clear to you.
+//
+
+
+#ifndef KDHOCKEYAPPQMLSTACKTRACE_P_H
+#define KDHOCKEYAPPQMLSTACKTRACE_P_H
+
+#include <QPointer>
+
+#include <memory>
+
+class QQmlEngine;
+
+namespace KDHockeyApp {
+
+/**
+ * Captures the QML stack trace of a crashing process.
+ *
+ * Qt's own qt_v4StackTrace() builds the trace from strings allocated on the heap,
+ * which deadlocks when the crash happened while the allocator's lock was held.
+ * Instead this class walks the V4 engine's chain of stack frames and writes the
+ * trace into a buffer that was allocated, and touched, in advance. The function
+ * names and source files are referenced by the compilation units, copying them
+ * only increments reference counters.
+ *
+ * Qt versions without that chain of stack frames still use qt_v4StackTrace().
+ */
+class QmlStackTrace
+{
+public:
+    explicit QmlStackTrace(int capacity = 16384);
+
+    void setEngine(QQmlEngine *engine);
+    QQmlEngine *engine() const;
+
+    // NOTICE: This gets called by the crash handler.
+    const char *capture() const;
+
+private:
+    Q_DISABLE_COPY(QmlStackTrace)
+
+    QPointer<QQmlEngine> m_engine;
+    const std::unique_ptr<char[]> m_buffer;
+    const int m_capacity;
+};
+
+} // namespace KDHockeyApp
+
+#endif // KDHOCKEYAPPQMLSTACKTRACE_P_H
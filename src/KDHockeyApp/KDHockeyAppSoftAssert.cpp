@@ -24,6 +24,8 @@
 
 #include "KDHockeyAppSoftAssert_p.h"
 
+#include <chrono>
+
 namespace KDHockeyApp {
 namespace Private {
 
@@ -31,6 +33,16 @@ namespace {
 
 Q_LOGGING_CATEGORY(lcSoftAssert, "kdab.softassert")
 
+std::atomic<SoftAssertReporter> s_reporter{nullptr};
+std::atomic<int> s_reportBurst{0};
+std::atomic<int> s_reportInterval{3600}; // in seconds
+
+qint64 currentTime()
+{
+    const auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::milliseconds>(now).count();
+}
+
 QDebug *debugStream(const char *file, int line, const char *function,
                     QMessageLogger::CategoryFunction categoryFunction)
 {
@@ -46,6 +58,73 @@ QDebug *debugStream(const char *file, int line, const char *function,
 
 } // namespace
 
+/*!
+    Takes a token from this call site's bucket. Returns \c false if the bucket
+    is empty. Otherwise \a occurrences tells how many failures, including this
+    one, the report stands for.
+*/
+bool SoftAssertSite::acquireReport(int *occurrences)
+{
+    const auto burst = s_reportBurst.load(std::memory_order_relaxed);
+    const auto interval = s_reportInterval.load(std::memory_order_relaxed) * qint64{1000};
+
+    if (burst <= 0)
+        return false;
+
+    m_failures.fetch_add(1, std::memory_order_relaxed);
+
+    const auto now = currentTime();
+    auto fullTime = m_fullTime.load(std::memory_order_relaxed);
+
+    do {
+        // the bucket is empty if it only becomes full in more than burst intervals
+        if (fullTime - now > (burst - 1) * interval)
+            return false;
+    } while (!m_fullTime.compare_exchange_weak(fullTime, qMax(fullTime, now) + interval, std::memory_order_relaxed));
+
+    *occurrences = qMax(m_failures.exchange(0, std::memory_order_relaxed), 1);
+    return true;
+}
+
+/*!
+    Installs the \a reporter function which writes non-fatal reports for failed
+    soft assertions. Passing \c nullptr disables these reports.
+*/
+void setSoftAssertReporter(SoftAssertReporter reporter)
+{
+    s_reporter.store(reporter);
+}
+
+/*!
+    Limits the non-fatal reports of each call site to \a burst reports in a row,
+    after which one more report becomes available every \a interval seconds.
+    A \a burst of zero disables these reports.
+*/
+void setSoftAssertReportLimit(int burst, int interval)
+{
+    s_reportBurst.store(qMax(burst, 0));
+    s_reportInterval.store(qMax(interval, 0));
+}
+
+int softAssertReportBurst()
+{
+    return s_reportBurst.load();
+}
+
+int softAssertReportInterval()
+{
+    return s_reportInterval.load();
+}
+
+void reportSoftAssert(SoftAssertSite &site, const char *file, int line, const char *expression)
+{
+    const auto reporter = s_reporter.load();
+    auto occurrences = 0;
+
+    if (reporter && site.acquireReport(&occurrences))
+        reporter(file, line, expression, occurrences);
+}
+
 SoftAssertLogger::SoftAssertLogger(const char *file, int line, const char *function, QMessageLogger::CategoryFunction categoryFunction)
     : m_debugStream(debugStream(file, line, function, categoryFunction))
 {
@@ -59,12 +138,13 @@ SoftAssertLogger::~SoftAssertLogger()
         qFatal("Aborting this test suite.");
 }
 
-bool softAssert(const char *file, int line, const char *function,
+bool softAssert(SoftAssertSite &site, const char *file, int line, const char *function,
                 QMessageLogger::CategoryFunction categoryFunction,
                 const char *expression)
 {
     SoftAssertLogger{file, line, function, categoryFunction}
             << "Assertion failed in" << function << ": " << expression;
+    reportSoftAssert(site, file, line, expression);
     return true;
 }
 
@@ -27,13 +27,23 @@
 
 #include <QLoggingCategory>
 
+#include <atomic>
+
+// Each call site owns a constant initialized SoftAssertSite, which is only touched when
+// the assertion fails. Passing assertions cost nothing but the branch on their condition.
+#define KD_SOFTASSERT_SITE() \
+    ([]() -> ::KDHockeyApp::Private::SoftAssertSite & { \
+        static ::KDHockeyApp::Private::SoftAssertSite site; \
+        return site; \
+    }())
+
 #define KD_SOFTASSERT_FAILED(category, condition) \
     Q_UNLIKELY(!(condition) && ::KDHockeyApp::Private::softAssert \
-        (QT_MESSAGELOG_FILE, QT_MESSAGELOG_LINE, QT_MESSAGELOG_FUNC, category, #condition))
+        (KD_SOFTASSERT_SITE(), QT_MESSAGELOG_FILE, QT_MESSAGELOG_LINE, QT_MESSAGELOG_FUNC, category, #condition))
 
 #define KD_SOFTASSERT_COMPARE_FAILED(category, actual, op, expected) \
     Q_UNLIKELY(!((actual) op (expected)) && ::KDHockeyApp::Private::softAssert \
-        (QT_MESSAGELOG_FILE, QT_MESSAGELOG_LINE, QT_MESSAGELOG_FUNC, category, \
+        (KD_SOFTASSERT_SITE(), QT_MESSAGELOG_FILE, QT_MESSAGELOG_LINE, QT_MESSAGELOG_FUNC, category, \
          (actual), (expected), #actual " " #op " " #expected))
 
 #define KD_SOFTASSERT_EQ_FAILED(category, actual, expected) \
@@ -46,6 +56,38 @@
 namespace KDHockeyApp {
 namespace Private {
 
+/**
+ * The state of a soft assertion's call site.
+ *
+ * Failing assertions may produce non-fatal reports. Their rate is limited per call
+ * site by a token bucket, implemented as generic cell rate algorithm: The site only
+ * stores the time at which its bucket would be full again, which gets updated by a
+ * single compare-and-swap. Failures without report are counted, and the next report
+ * tells how many failures it stands for.
+ */
+class SoftAssertSite
+{
+public:
+    constexpr SoftAssertSite() = default;
+
+    bool acquireReport(int *occurrences);
+
+private:
+    Q_DISABLE_COPY(SoftAssertSite)
+
+    std::atomic<qint64> m_fullTime{0};
+    std::atomic<int> m_failures{0};
+};
+
+using SoftAssertReporter = void (*)(const char *file, int line, const char *expression, int occurrences);
+
+void setSoftAssertReporter(SoftAssertReporter reporter);
+void setSoftAssertReportLimit(int burst, int interval);
+int softAssertReportBurst();
+int softAssertReportInterval();
+
+void reportSoftAssert(SoftAssertSite &site, const char *file, int line, const char *expression);
+
 class SoftAssertLogger
 {
 public:
@@ -66,12 +108,12 @@ private:
     QDebug *const m_debugStream;
 };
 
-Q_REQUIRED_RESULT bool softAssert(const char *file, int line, const char *function,
+Q_REQUIRED_RESULT bool softAssert(SoftAssertSite &site, const char *file, int line, const char *function,
                                   QMessageLogger::CategoryFunction categoryFunction,
                                   const char *expression);
 
 template<typename T, typename U>
-Q_REQUIRED_RESULT inline bool softAssert(const char *file, int line, const char *function,
+Q_REQUIRED_RESULT inline bool softAssert(SoftAssertSite &site, const char *file, int line, const char *function,
                                          QMessageLogger::CategoryFunction categoryFunction,
                                          const T &actualValue, const U &expectedValue,
                                          const char *expression)
@@ -79,6 +121,7 @@ Q_REQUIRED_RESULT inline bool softAssert(const char *file, int line, const char
     SoftAssertLogger{file, line, function, categoryFunction}
             << "Assertion failed" << function << ": " << expression
             << " (actual value: " << actualValue << ", expected value: " << expectedValue << ")";
+    reportSoftAssert(site, file, line, expression);
     return true;
 }
 
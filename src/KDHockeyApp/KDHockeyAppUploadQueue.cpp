@@ -0,0 +1,377 @@
+//
+// Copyright (C) 2017 Klaralvdalens Datakonsult AB, a KDAB Group company, info@kdab.com.
+// All rights reserved.
+//
+// This file is part of the KD HockeyApp library.
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of either:
+//
+//   The GNU Lesser General Public License version 2.1 and version 3
+//   as published by the Free Software Foundation and appearing in the
+//   file LICENSE.LGPL.txt included.
+//
+// Or:
+//
+//   The Mozilla Public License Version 2.0 as published by the Mozilla
+//   Foundation and appearing in the file LICENSE.MPL2.txt included.
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Contact info@kdab.com if any conditions of this licensing is not clear to you.
+//
+
+
+#include "KDHockeyAppUploadQueue_p.h"
+
+#include "KDHockeyAppCrashSignature_p.h"
+#include "KDHockeyAppCrashSpool_p.h"
+#include "KDHockeyAppLiterals_p.h"
+#include "KDHockeyAppManager.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QLoggingCategory>
+#include <QNetworkReply>
+#include <QSettings>
+#include <QtConcurrentRun>
+
+#include <algorithm>
+
+namespace KDHockeyApp {
+
+Q_DECLARE_LOGGING_CATEGORY(lcHockeyApp)
+
+namespace {
+
+constexpr int maximumAttempts = 8;
+constexpr qint64 initialRetryDelay = 30 * 1000;
+constexpr qint64 maximumRetryDelay = 6 * 60 * 60 * 1000;
+
+const auto s_stateFileName = QStringLiteral("uploads.ini");
+const auto s_stateAttempts = QStringLiteral("%1/Attempts");
+const auto s_stateNotBefore = QStringLiteral("%1/NotBefore");
+const auto s_stateOccurrences = QStringLiteral("%1/Occurrences");
+
+} // namespace
+
+UploadQueue::UploadQueue(HockeyAppManager *manager, CrashSignatureIndex *signatures, CrashSpool *spool,
+                         Preparer prepare, Poster post)
+    : m_manager{manager}
+    , m_signatures{signatures}
+    , m_spool{spool}
+    , m_prepare{std::move(prepare)}
+    , m_post{std::move(post)}
+{
+    m_retryTimer.setSingleShot(true);
+    QObject::connect(&m_retryTimer, &QTimer::timeout, m_manager, [this] {
+        startUploads();
+    });
+
+    // The spool evicts on its worker thread. The retry timer shares our thread and
+    // lifetime, so that evictions reported after our destruction get dropped.
+    m_spool->setEvictionHandler([this](const QString &crashId) {
+        QMetaObject::invokeMethod(&m_retryTimer, [this, crashId] { discard(crashId); }, Qt::QueuedConnection);
+    });
+}
+
+UploadQueue::~UploadQueue()
+{
+    m_spool->setEvictionHandler({});
+
+    // the scans record signatures in the index, which doesn't outlive us
+    m_scans.waitForFinished();
+}
+
+/*!
+    Limits the number of uploads running at the same time to \a count.
+*/
+void UploadQueue::setMaximumActiveUploads(int count)
+{
+    m_maximumActiveUploads = qMax(1, count);
+    startUploads();
+}
+
+/*!
+    Scans \a dirPath for crash reports on a worker thread, adds those not
+    queued yet and starts uploading them. Reports which exhausted their
+    attempts in previous sessions are deleted. Reports which are repeats
+    of a known crash get dropped, if the crash signature index says so.
+*/
+void UploadQueue::enqueueCrashDumps(const QString &dirPath)
+{
+    m_stateFileName = QDir{dirPath}.filePath(s_stateFileName);
+
+    const auto watcher = new QFutureWatcher<QVector<Entry>>{m_manager};
+
+    QObject::connect(watcher, &QFutureWatcherBase::finished, m_manager, [this, watcher] {
+        addCrashDumps(watcher->result());
+        watcher->deleteLater();
+    });
+
+    // forget about finished scans, so that they don't pile up over long sessions
+    const auto scans = m_scans.futures();
+
+    if (std::all_of(scans.cbegin(), scans.cend(), [](const QFuture<QVector<Entry>> &scan) {
+                        return scan.isFinished();
+                    }))
+        m_scans.clearFutures();
+
+    const auto scan = QtConcurrent::run(&UploadQueue::findCrashDumps, dirPath, m_stateFileName, m_signatures);
+    m_scans.addFuture(scan);
+    watcher->setFuture(scan);
+}
+
+QVector<UploadQueue::Entry> UploadQueue::findCrashDumps(const QString &dirPath, const QString &stateFileName,
+                                                        CrashSignatureIndex *signatures)
+{
+    QSettings state{stateFileName, QSettings::IniFormat};
+    QVector<Entry> entries;
+    QSet<QString> knownIds;
+
+    for (QDirIterator it{dirPath, {"*.dmp"_l1}}; it.hasNext(); ) {
+        const QFileInfo fileInfo{it.next()};
+
+        Entry entry;
+        entry.dumpFileName = fileInfo.filePath();
+        entry.crashId = fileInfo.baseName();
+        entry.lastModified = fileInfo.lastModified().toMSecsSinceEpoch();
+        entry.attempts = state.value(s_stateAttempts.arg(entry.crashId)).toInt();
+        entry.notBefore = state.value(s_stateNotBefore.arg(entry.crashId)).toLongLong();
+
+        if (entry.attempts >= maximumAttempts) {
+            qCInfo(lcHockeyApp, "Removing crash report %ls after %d failed attempts",
+                   qUtf16Printable(entry.crashId), entry.attempts);
+            removeCrashFiles(fileInfo);
+            continue;
+        }
+
+        // each report gets recorded in the signature index only once
+        if (signatures->fullReportLimit() > 0) {
+            const auto occurrences = state.value(s_stateOccurrences.arg(entry.crashId));
+
+            if (occurrences.isValid()) {
+                entry.occurrences = occurrences.toInt();
+            } else {
+                entry.occurrences = signatures->record(CrashSignature::fromMiniDump(entry.dumpFileName));
+
+                if (entry.occurrences == 0) {
+                    qCInfo(lcHockeyApp, "Dropping crash report %ls, which repeats a known crash",
+                           qUtf16Printable(entry.crashId));
+                    removeCrashFiles(fileInfo);
+                    continue;
+                }
+
+                state.setValue(s_stateOccurrences.arg(entry.crashId), entry.occurrences);
+            }
+        }
+
+        knownIds.insert(entry.crashId);
+        entries.append(entry);
+    }
+
+    // forget about reports which have been removed meanwhile
+    for (const auto &crashId: state.childGroups()) {
+        if (!knownIds.contains(crashId))
+            state.remove(crashId);
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry &lhs, const Entry &rhs) {
+        return lhs.lastModified > rhs.lastModified;
+    });
+
+    return entries;
+}
+
+void UploadQueue::removeCrashFiles(const QFileInfo &dumpFileInfo)
+{
+    const auto dir = dumpFileInfo.dir();
+
+    for (const auto &fileName: dir.entryList({dumpFileInfo.completeBaseName() + ".*"_l1}, QDir::Files))
+        QFile::remove(dir.filePath(fileName));
+}
+
+void UploadQueue::addCrashDumps(const QVector<Entry> &entries)
+{
+    if (m_pending.isEmpty() && m_active.isEmpty())
+        m_completed = m_total = 0;
+
+    for (const auto &entry: entries) {
+        if (m_active.contains(entry.crashId)
+                || std::any_of(m_pending.cbegin(), m_pending.cend(), [&entry](const Entry &pending) {
+                        return pending.crashId == entry.crashId;
+                    }))
+            continue;
+
+        m_pending.append(entry);
+        ++m_total;
+    }
+
+    std::stable_sort(m_pending.begin(), m_pending.end(), [](const Entry &lhs, const Entry &rhs) {
+        return lhs.lastModified > rhs.lastModified;
+    });
+
+    reportProgress();
+    startUploads();
+}
+
+UploadQueue::Result UploadQueue::result(const QNetworkReply *reply)
+{
+    if (reply->error() == QNetworkReply::NoError)
+        return Succeeded;
+
+    const auto status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    // client errors won't go away by trying again, except for timeouts and throttling
+    if (status >= 400 && status < 500 && status != 408 && status != 429)
+        return Rejected;
+
+    return Retry;
+}
+
+qint64 UploadQueue::retryDelay(int attempts)
+{
+    auto delay = initialRetryDelay;
+
+    for (auto i = 1; i < attempts && delay < maximumRetryDelay; ++i)
+        delay *= 2;
+
+    return qMin(delay, maximumRetryDelay);
+}
+
+void UploadQueue::startUploads()
+{
+    const auto now = QDateTime::currentMSecsSinceEpoch();
+
+    for (auto it = m_pending.begin(); it != m_pending.end() && m_active.count() < m_maximumActiveUploads; ) {
+        if (it->notBefore > now) {
+            ++it;
+            continue;
+        }
+
+        const auto entry = *it;
+        it = m_pending.erase(it);
+        m_active.insert(entry.crashId);
+        m_spool->beginUpload(entry.crashId);
+
+        const auto watcher = new QFutureWatcher<CrashReport>{m_manager};
+
+        QObject::connect(watcher, &QFutureWatcherBase::finished, m_manager, [this, watcher, entry] {
+            postCrashReport(entry, watcher->result());
+            watcher->deleteLater();
+        });
+
+        watcher->setFuture(m_prepare(entry.dumpFileName, entry.occurrences));
+    }
+
+    scheduleRetry();
+}
+
+/*!
+    Forgets about the report \a crashId, after the crash spool evicted it.
+*/
+void UploadQueue::discard(const QString &crashId)
+{
+    const auto it = std::find_if(m_pending.begin(), m_pending.end(), [&crashId](const Entry &entry) {
+        return entry.crashId == crashId;
+    });
+
+    if (it != m_pending.end()) {
+        m_pending.erase(it);
+        ++m_completed;
+
+        reportProgress();
+        scheduleRetry();
+    }
+
+    if (!m_stateFileName.isEmpty())
+        removeState(crashId);
+}
+
+void UploadQueue::postCrashReport(const Entry &entry, const CrashReport &report)
+{
+    const auto reply = m_post(report);
+
+    if (!reply) {
+        m_active.remove(entry.crashId);
+        m_spool->endUpload(entry.crashId);
+        finishUpload(entry, Rejected, QStringLiteral("Could not read crash report"));
+        startUploads();
+        return;
+    }
+
+    QObject::connect(reply, &QNetworkReply::finished, m_manager, [this, reply, entry] {
+        m_active.remove(entry.crashId);
+        m_spool->endUpload(entry.crashId);
+        finishUpload(entry, result(reply), reply->errorString());
+        startUploads();
+    });
+}
+
+void UploadQueue::finishUpload(Entry entry, Result result, const QString &errorString)
+{
+    if (result == Succeeded) {
+        removeState(entry.crashId);
+        ++m_completed;
+
+        emit m_manager->crashDumpUploaded(entry.crashId);
+        reportProgress();
+        return;
+    }
+
+    entry.attempts = (result == Rejected ? maximumAttempts : entry.attempts + 1);
+
+    if (entry.attempts < maximumAttempts) {
+        entry.notBefore = QDateTime::currentMSecsSinceEpoch() + retryDelay(entry.attempts);
+        m_pending.append(entry);
+        storeState(entry);
+    } else {
+        // reports which never will be uploaded would only waste storage
+        qCInfo(lcHockeyApp, "Removing crash report %ls, which could not be uploaded", qUtf16Printable(entry.crashId));
+        removeState(entry.crashId);
+        QtConcurrent::run(&UploadQueue::removeCrashFiles, QFileInfo{entry.dumpFileName});
+        ++m_completed;
+    }
+
+    emit m_manager->crashDumpUploadFailed(entry.crashId, errorString);
+    reportProgress();
+}
+
+void UploadQueue::scheduleRetry()
+{
+    if (m_pending.isEmpty() || m_active.count() >= m_maximumActiveUploads) {
+        m_retryTimer.stop();
+        return;
+    }
+
+    const auto next = std::min_element(m_pending.cbegin(), m_pending.cend(), [](const Entry &lhs, const Entry &rhs) {
+        return lhs.notBefore < rhs.notBefore;
+    });
+
+    const auto delay = next->notBefore - QDateTime::currentMSecsSinceEpoch();
+    m_retryTimer.start(static_cast<int>(qBound<qint64>(0, delay, maximumRetryDelay)));
+}
+
+void UploadQueue::reportProgress()
+{
+    emit m_manager->crashDumpUploadProgress(m_completed, m_total);
+}
+
+void UploadQueue::storeState(const Entry &entry)
+{
+    QSettings state{m_stateFileName, QSettings::IniFormat};
+    state.setValue(s_stateAttempts.arg(entry.crashId), entry.attempts);
+    state.setValue(s_stateNotBefore.arg(entry.crashId), entry.notBefore);
+}
+
+void UploadQueue::removeState(const QString &crashId)
+{
+    QSettings{m_stateFileName, QSettings::IniFormat}.remove(crashId);
+}
+
+} // namespace KDHockeyApp
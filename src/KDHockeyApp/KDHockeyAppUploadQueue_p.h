@@ -0,0 +1,151 @@
+//
+// Copyright (C) 2017 Klaralvdalens Datakonsult AB, a KDAB Group company, info@kdab.com.
+// All rights reserved.
+//
+// This file is part of the KD HockeyApp library.
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of either:
+//
+//   The GNU Lesser General Public License version 2.1 and version 3
+//   as published by the Free Software Foundation and appearing in the
+//   file LICENSE.LGPL.txt included.
+//
+// Or:
+//
+//   The Mozilla Public License Version 2.0 as published by the Mozilla
+//   Foundation and appearing in the file LICENSE.MPL2.txt included.
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Contact info@kdab.com if any conditions of this licensing is not clear to you.
+//
+
+
+#ifndef KDHOCKEYAPPUPLOADQUEUE_P_H
+#define KDHOCKEYAPPUPLOADQUEUE_P_H
+
+#include <QFuture>
+#include <QFutureSynchronizer>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+
+#include <functional>
+
+QT_BEGIN_NAMESPACE
+class QFileInfo;
+class QHttpMultiPart;
+class QNetworkReply;
+QT_END_NAMESPACE
+
+namespace KDHockeyApp {
+
+class CrashSignatureIndex;
+class CrashSpool;
+class HockeyAppManager;
+
+/**
+ * A crash report ready for uploading. The form data is \c nullptr
+ * if the report could not be prepared.
+ */
+struct CrashReport
+{
+    QString crashId;
+    QStringList crashFiles;
+    QHttpMultiPart *formData = nullptr;
+};
+
+/**
+ * Schedules the upload of crash reports found in the crash directory.
+ *
+ * Only a limited number of uploads is active at any time, so that a large
+ * backlog of reports neither floods the network, nor opens hundreds of files.
+ * Newest reports get uploaded first, as they are most relevant for the current
+ * version of the application. Failed uploads are retried with exponentially
+ * growing delays, unless the server rejected the report. The number of attempts
+ * and the time of the next attempt are stored next to the reports, so that this
+ * progress survives restarts of the application. Reports which got rejected, or
+ * exhausted their attempts, are deleted together with their state.
+ *
+ * Newly found reports are checked against the crash signature index, which drops
+ * repeats of the same crash beyond its limits. The reports that do get uploaded
+ * carry the number of crashes they stand for.
+ *
+ * Reports are protected from eviction by the crash spool while they are being
+ * uploaded. Queued reports which the spool evicts are forgotten with their state.
+ *
+ * Scanning the crash directory and preparing reports happens on worker
+ * threads, only posting the prepared reports happens on the manager's thread.
+ */
+class UploadQueue
+{
+public:
+    using Preparer = std::function<QFuture<CrashReport>(const QString &dumpFileName, int occurrences)>;
+    using Poster = std::function<QNetworkReply *(const CrashReport &report)>;
+
+    explicit UploadQueue(HockeyAppManager *manager, CrashSignatureIndex *signatures, CrashSpool *spool,
+                         Preparer prepare, Poster post);
+    ~UploadQueue();
+
+    void setMaximumActiveUploads(int count);
+    int maximumActiveUploads() const { return m_maximumActiveUploads; }
+
+    void enqueueCrashDumps(const QString &dirPath);
+
+    int pendingCount() const { return m_pending.count(); }
+    int activeCount() const { return m_active.count(); }
+
+private:
+    Q_DISABLE_COPY(UploadQueue)
+
+    struct Entry
+    {
+        QString dumpFileName;
+        QString crashId;
+        qint64 lastModified = 0;
+        int attempts = 0;
+        qint64 notBefore = 0;
+        int occurrences = 1;
+    };
+
+    enum Result { Succeeded, Retry, Rejected };
+
+    static Result result(const QNetworkReply *reply);
+    static qint64 retryDelay(int attempts);
+    static QVector<Entry> findCrashDumps(const QString &dirPath, const QString &stateFileName,
+                                         CrashSignatureIndex *signatures);
+    static void removeCrashFiles(const QFileInfo &dumpFileInfo);
+
+    void addCrashDumps(const QVector<Entry> &entries);
+    void startUploads();
+    void discard(const QString &crashId);
+    void postCrashReport(const Entry &entry, const CrashReport &report);
+    void finishUpload(Entry entry, Result result, const QString &errorString);
+    void scheduleRetry();
+    void reportProgress();
+
+    void storeState(const Entry &entry);
+    void removeState(const QString &crashId);
+
+    HockeyAppManager *const m_manager;
+    CrashSignatureIndex *const m_signatures;
+    CrashSpool *const m_spool;
+    const Preparer m_prepare;
+    const Poster m_post;
+    QString m_stateFileName;
+    QVector<Entry> m_pending;
+    QSet<QString> m_active;
+    QTimer m_retryTimer;
+    QFutureSynchronizer<QVector<Entry>> m_scans;
+    int m_maximumActiveUploads = 2;
+    int m_completed = 0;
+    int m_total = 0;
+};
+
+} // namespace KDHockeyApp
+
+#endif // KDHOCKEYAPPUPLOADQUEUE_P_H
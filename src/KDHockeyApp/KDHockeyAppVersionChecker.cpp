@@ -0,0 +1,224 @@
+//
+// Copyright (C) 2017 Klaralvdalens Datakonsult AB, a KDAB Group company, info@kdab.com.
+// All rights reserved.
+//
+// This file is part of the KD HockeyApp library.
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of either:
+//
+//   The GNU Lesser General Public License version 2.1 and version 3
+//   as published by the Free Software Foundation and appearing in the
+//   file LICENSE.LGPL.txt included.
+//
+// Or:
+//
+//   The Mozilla Public License Version 2.0 as published by the Mozilla
+//   Foundation and appearing in the file LICENSE.MPL2.txt included.
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Contact info@kdab.com if any conditions of this licensing is not clear to you.
+//
+
+
+#include "KDHockeyAppVersionChecker_p.h"
+
+#include "KDHockeyAppLiterals_p.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLoggingCategory>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QSaveFile>
+#include <QSettings>
+#include <QTimer>
+
+#include <algorithm>
+
+namespace KDHockeyApp {
+
+Q_DECLARE_LOGGING_CATEGORY(lcHockeyApp)
+
+namespace {
+
+const auto s_cacheEntityTag = QStringLiteral("ETag");
+const auto s_cacheLastModified = QStringLiteral("LastModified");
+const auto s_cacheFetchTime = QStringLiteral("FetchTime");
+
+QString cacheInfoFileName(const QString &cacheFileName)
+{
+    return cacheFileName + ".ini"_l1;
+}
+
+} // namespace
+
+VersionChecker::VersionChecker(const QString &cacheFileName)
+    : m_cacheFileName{cacheFileName}
+{}
+
+/*!
+    Reports the versions available at \a url to \a callback, which
+    is invoked in the thread of \a context, unless that got destroyed.
+    The callback isn't invoked if the versions cannot be fetched.
+*/
+void VersionChecker::check(QNetworkAccessManager *network, const QUrl &url, QObject *context, Callback callback)
+{
+    const auto now = QDateTime::currentMSecsSinceEpoch();
+    const auto haveCache = loadCache();
+
+    if (haveCache && now - m_fetchTime < m_minimumRefreshInterval) {
+        QTimer::singleShot(0, context, [this, callback] {
+            callback(m_versions);
+        });
+
+        return;
+    }
+
+    QNetworkRequest request{url};
+
+    if (haveCache) {
+        if (!m_entityTag.isEmpty())
+            request.setRawHeader("If-None-Match", m_entityTag);
+        if (!m_lastModified.isEmpty())
+            request.setRawHeader("If-Modified-Since", m_lastModified);
+    }
+
+    const auto reply = network->get(request);
+
+    QObject::connect(reply, &QNetworkReply::finished, context, [this, reply, haveCache, callback] {
+        reply->deleteLater();
+
+        if (reply->error() != QNetworkReply::NoError) {
+            qCWarning(lcHockeyApp, "Failed to query app versions: %ls %d",
+                      qUtf16Printable(reply->errorString()), reply->error());
+            return;
+        }
+
+        const auto status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+        if (status == 304 && haveCache) {
+            touchCache();
+            callback(m_versions);
+            return;
+        }
+
+        const auto json = reply->readAll();
+
+        QString errorString;
+        auto versions = parse(json, &errorString);
+
+        if (!errorString.isEmpty()) {
+            qCWarning(lcHockeyApp, "Failed to query app versions: %ls", qUtf16Printable(errorString));
+            return;
+        }
+
+        m_versions = std::move(versions);
+        storeCache(json, reply);
+        callback(m_versions);
+    });
+}
+
+/*!
+    Parses the version list \a json, and sorts it by descending version
+    and timestamp. Returns an empty list and sets \a errorString on errors.
+*/
+QVector<VersionChecker::Version> VersionChecker::parse(const QByteArray &json, QString *errorString)
+{
+    QJsonParseError parseError;
+    const auto entries = QJsonDocument::fromJson(json, &parseError).array();
+
+    if (parseError.error != QJsonParseError::NoError) {
+        *errorString = parseError.errorString();
+        return {};
+    }
+
+    QVector<Version> versions;
+    versions.reserve(entries.size());
+
+    for (const auto &value: entries) {
+        const auto entry = value.toObject();
+
+        Version version;
+        version.version = QVersionNumber::fromString(entry["version"_l1].toString());
+        version.versionName = entry["shortversion"_l1].toString();
+        version.timestamp = qRound64(entry["timestamp"_l1].toDouble() * 1000);
+        version.size = qRound64(entry["appsize"_l1].toDouble());
+        version.notes = entry["notes"_l1].toString();
+        version.mandatory = entry["mandatory"_l1].toBool();
+        version.minimumPlatformVersion = QVersionNumber::fromString(entry["minimum_os_version"_l1].toString());
+
+        versions.append(std::move(version));
+    }
+
+    std::sort(versions.begin(), versions.end(), [](const Version &lhs, const Version &rhs) {
+        if (lhs.version != rhs.version)
+            return lhs.version > rhs.version;
+
+        return lhs.timestamp > rhs.timestamp;
+    });
+
+    return versions;
+}
+
+bool VersionChecker::loadCache()
+{
+    if (m_cacheLoaded)
+        return true;
+
+    QFile file{m_cacheFileName};
+
+    if (!file.open(QFile::ReadOnly))
+        return false;
+
+    QString errorString;
+    auto versions = parse(file.readAll(), &errorString);
+
+    if (!errorString.isEmpty()) {
+        qCWarning(lcHockeyApp, "Ignoring invalid version cache: %ls", qUtf16Printable(errorString));
+        return false;
+    }
+
+    const QSettings info{cacheInfoFileName(m_cacheFileName), QSettings::IniFormat};
+
+    m_versions = std::move(versions);
+    m_entityTag = info.value(s_cacheEntityTag).toByteArray();
+    m_lastModified = info.value(s_cacheLastModified).toByteArray();
+    m_fetchTime = info.value(s_cacheFetchTime).toLongLong();
+    m_cacheLoaded = true;
+
+    return true;
+}
+
+void VersionChecker::storeCache(const QByteArray &json, const QNetworkReply *reply)
+{
+    m_entityTag = reply->rawHeader("ETag");
+    m_lastModified = reply->rawHeader("Last-Modified");
+    m_fetchTime = QDateTime::currentMSecsSinceEpoch();
+    m_cacheLoaded = true;
+
+    QSaveFile file{m_cacheFileName};
+
+    if (!file.open(QFile::WriteOnly) || file.write(json) != json.size() || !file.commit()) {
+        qCWarning(lcHockeyApp, "Could not store version cache %ls: %ls",
+                  qUtf16Printable(m_cacheFileName), qUtf16Printable(file.errorString()));
+        return;
+    }
+
+    QSettings info{cacheInfoFileName(m_cacheFileName), QSettings::IniFormat};
+    info.setValue(s_cacheEntityTag, m_entityTag);
+    info.setValue(s_cacheLastModified, m_lastModified);
+    info.setValue(s_cacheFetchTime, m_fetchTime);
+}
+
+void VersionChecker::touchCache()
+{
+    m_fetchTime = QDateTime::currentMSecsSinceEpoch();
+    QSettings{cacheInfoFileName(m_cacheFileName), QSettings::IniFormat}.setValue(s_cacheFetchTime, m_fetchTime);
+}
+
+} // namespace KDHockeyApp
@@ -0,0 +1,99 @@
+//
+// Copyright (C) 2017 Klaralvdalens Datakonsult AB, a KDAB Group company, info@kdab.com.
+// All rights reserved.
+//
+// This file is part of the KD HockeyApp library.
+//
+// This library is free software; you can redistribute it and/or modify
+// it under the terms of either:
+//
+//   The GNU Lesser General Public License version 2.1 and version 3
+//   as published by the Free Software Foundation and appearing in the
+//   file LICENSE.LGPL.txt included.
+//
+// Or:
+//
+//   The Mozilla Public License Version 2.0 as published by the Mozilla
+//   Foundation and appearing in the file LICENSE.MPL2.txt included.
+//
+// This file is provided AS IS with NO WARRANTY OF ANY KIND, INCLUDING THE
+// WARRANTY OF DESIGN, MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE.
+//
+// Contact info@kdab.com if any conditions of this licensing is not clear to you.
+//
+
+
+#ifndef KDHOCKEYAPPVERSIONCHECKER_P_H
+#define KDHOCKEYAPPVERSIONCHECKER_P_H
+
+#include <QDateTime>
+#include <QString>
+#include <QVector>
+#include <QVersionNumber>
+
+#include <functional>
+
+QT_BEGIN_NAMESPACE
+class QNetworkAccessManager;
+class QNetworkReply;
+class QObject;
+class QUrl;
+QT_END_NAMESPACE
+
+namespace KDHockeyApp {
+
+/**
+ * Fetches the list of versions available for an application.
+ *
+ * The response is cached on disk, together with its \c ETag and \c Last-Modified
+ * headers. Within the minimum refresh interval the cached list is reported
+ * without any request. After that a conditional request is sent, so that an
+ * unchanged list doesn't get transferred and parsed again.
+ *
+ * The list gets parsed once into typed entries, sorted by descending version.
+ */
+class VersionChecker
+{
+public:
+    struct Version
+    {
+        QVersionNumber version;
+        QString versionName;
+        qint64 timestamp = 0;
+        qint64 size = 0;
+        QString notes;
+        bool mandatory = false;
+        QVersionNumber minimumPlatformVersion;
+    };
+
+    using Callback = std::function<void(const QVector<Version> &versions)>;
+
+    explicit VersionChecker(const QString &cacheFileName);
+
+    void setMinimumRefreshInterval(qint64 interval) { m_minimumRefreshInterval = interval; }
+    qint64 minimumRefreshInterval() const { return m_minimumRefreshInterval; }
+
+    void check(QNetworkAccessManager *network, const QUrl &url, QObject *context, Callback callback);
+
+    static QVector<Version> parse(const QByteArray &json, QString *errorString);
+
+private:
+    Q_DISABLE_COPY(VersionChecker)
+
+    bool loadCache();
+    void storeCache(const QByteArray &json, const QNetworkReply *reply);
+    void touchCache();
+
+    const QString m_cacheFileName;
+    qint64 m_minimumRefreshInterval = 15 * 60 * 1000;
+
+    bool m_cacheLoaded = false;
+    QVector<Version> m_versions;
+    QByteArray m_entityTag;
+    QByteArray m_lastModified;
+    qint64 m_fetchTime = 0;
+};
+
+} // namespace KDHockeyApp
+
+#endif // KDHOCKEYAPPVERSIONCHECKER_P_H
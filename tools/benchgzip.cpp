@@ -0,0 +1,94 @@
+#include "KDHockeyAppGzipDevice_p.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryFile>
+
+namespace KDHockeyApp {
+
+// Compresses crash report attachments, like minidumps and binary logs, with
+// GzipDevice the same way uploads do, and reports the size reduction and the
+// throughput for each compression level.
+class BenchGzip : public QCoreApplication
+{
+public:
+    using QCoreApplication::QCoreApplication;
+
+    int run()
+    {
+        QCommandLineParser args;
+        args.addOption({"levels", "LIST", "Comma separated list of compression levels to compare", "1,6,9"});
+        args.addPositionalArgument("FILE", "The files to compress, e.g. minidumps of Breakpad's processor testdata");
+        args.parse(arguments());
+
+        const auto fileNames = args.positionalArguments();
+
+        if (fileNames.isEmpty())
+            return EXIT_FAILURE;
+
+        for (const auto &level: args.value("levels").split(',')) {
+            bool valid = false;
+            const auto compressionLevel = level.toInt(&valid);
+
+            if (!valid || compressionLevel < 0 || compressionLevel > 9)
+                return EXIT_FAILURE;
+
+            if (!measure(fileNames, compressionLevel))
+                return EXIT_FAILURE;
+        }
+
+        return EXIT_SUCCESS;
+    }
+
+private:
+    static bool measure(const QStringList &fileNames, int level)
+    {
+        qint64 totalSize = 0;
+        qint64 compressedSize = 0;
+        qint64 elapsed = 0;
+
+        for (const auto &fileName: fileNames) {
+            QFile source{fileName};
+            QTemporaryFile target;
+
+            if (!source.open(QFile::ReadOnly)) {
+                qWarning("Could not open %ls: %ls", qUtf16Printable(fileName), qUtf16Printable(source.errorString()));
+                return false;
+            }
+
+            if (!target.open()) {
+                qWarning("Could not create temporary file: %ls", qUtf16Printable(target.errorString()));
+                return false;
+            }
+
+            QElapsedTimer timer;
+            timer.start();
+
+            if (!GzipDevice::compress(&source, &target, level)) {
+                qWarning("Could not compress %ls", qUtf16Printable(fileName));
+                return false;
+            }
+
+            elapsed += timer.nsecsElapsed();
+            totalSize += source.size();
+            compressedSize += target.size();
+        }
+
+        qInfo("level %d: %d files, %lld bytes -> %lld bytes (%.1f%%), %.1f MiB/s",
+              level, fileNames.count(), totalSize, compressedSize,
+              totalSize > 0 ? 100.0 * compressedSize / totalSize : 0.0,
+              elapsed > 0 ? 1e9 * totalSize / elapsed / (1 << 20) : 0.0);
+
+        return true;
+    }
+};
+
+} // namespace KDHockeyApp
+
+int main(int argc, char *argv[])
+{
+    return KDHockeyApp::BenchGzip{argc, argv}.run();
+}
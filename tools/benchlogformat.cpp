@@ -0,0 +1,178 @@
+#include "KDHockeyAppLogBuffer_p.h"
+#include "KDHockeyAppLogFormatter_p.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+
+#include <atomic>
+#include <cstdlib>
+
+namespace {
+
+std::atomic<qint64> allocationCount{0};
+
+} // namespace
+
+#ifdef __GLIBC__
+
+// Qt allocates its containers with malloc(), therefore the allocations are counted there.
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+
+void *malloc(size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size)
+{
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(pointer, size);
+}
+
+} // extern "C"
+
+#endif // __GLIBC__
+
+namespace KDHockeyApp {
+
+// Compares the allocation free formatting of crash log records with the QString
+// concatenation the message handler used before. Both variants append to the same
+// kind of log ring, so that only the formatting differs.
+class BenchLogFormat : public QCoreApplication
+{
+public:
+    using QCoreApplication::QCoreApplication;
+
+    int run()
+    {
+        QCommandLineParser args;
+        args.addOption({"messages", "COUNT", "Number of messages to format per variant", "1000000"});
+        args.parse(arguments());
+
+        const auto count = args.value("messages").toInt();
+
+        if (count < 1)
+            return EXIT_FAILURE;
+
+        QMessageLogContext context{"benchlogformat.cpp", 42, "int KDHockeyApp::BenchLogFormat::run()", "kdhockeyapp.bench"};
+        const auto message = QStringLiteral("Loaded 42 items from the model, the first one is »héllo«");
+
+        LogBuffer textLog{s_logCapacity};
+        LogBuffer binaryLog{s_logCapacity};
+        LogBuffer definitions{s_logCapacity};
+        LogStringTable strings{&definitions};
+
+        binaryLog.setBinary(true);
+
+        measure("QString concatenation", count, [&] {
+            appendWithQString(&textLog, QtWarningMsg, context, message);
+        });
+
+        measure("LogFormatter, text records", count, [&] {
+            char buffer[s_recordCapacity];
+            LogFormatter record{buffer};
+            record.appendTextRecord(QtWarningMsg, context, message);
+            textLog.append(record.data(), record.size());
+        });
+
+        quint64 timestamp = 0;
+
+        measure("LogFormatter, binary records", count, [&] {
+            char buffer[s_recordCapacity];
+            LogFormatter record{buffer};
+            record.appendBinaryRecord(QtWarningMsg, context, message, ++timestamp, &strings);
+            binaryLog.append(record.data(), record.size());
+        });
+
+        return EXIT_SUCCESS;
+    }
+
+private:
+    template<typename Function>
+    static void measure(const char *name, int count, const Function &function)
+    {
+        function(); // warm up, and intern the strings of binary records
+
+        const auto allocations = allocationCount.load();
+        QElapsedTimer timer;
+        timer.start();
+
+        for (auto i = 0; i < count; ++i)
+            function();
+
+        const auto elapsed = timer.nsecsElapsed();
+
+        // without glibc the allocations are not counted, and reported as zero
+        qInfo("%-30s %12.0f msgs/s %8.2f allocs/msg %8.1f ns/msg", name,
+              1e9 * count / elapsed, static_cast<double>(allocationCount.load() - allocations) / count,
+              static_cast<double>(elapsed) / count);
+    }
+
+    // the message handler's formatting before LogFormatter got introduced
+    static void appendWithQString(LogBuffer *log, QtMsgType type, const QMessageLogContext &context, const QString &message)
+    {
+        QString tmp;
+
+        switch (type) {
+        case QtDebugMsg:
+            tmp += QLatin1String{"[D] "};
+            break;
+        case QtWarningMsg:
+            tmp += QLatin1String{"[W] "};
+            break;
+        case QtCriticalMsg:
+            tmp += QLatin1String{"[C] "};
+            break;
+        case QtFatalMsg:
+            tmp += QLatin1String{"[F] "};
+            break;
+        case QtInfoMsg:
+            tmp += QLatin1String{"[I] "};
+            break;
+        }
+
+        if (context.category) {
+            tmp.append(QString::fromLatin1(context.category));
+            tmp.append(QLatin1String{": "});
+        }
+
+        if (context.function) {
+            tmp.append(QString::fromLatin1(context.function));
+
+            if (context.line > 0) {
+                tmp.append(QLatin1String{", line "});
+                tmp.append(QString::number(context.line));
+            }
+
+            tmp.append(QLatin1String{": "});
+        }
+
+        tmp.append(message);
+        tmp.append(QLatin1Char{'\n'});
+
+        const auto utf8Data = tmp.toUtf8();
+        log->append(utf8Data.constData(), utf8Data.size());
+    }
+
+    static constexpr int s_logCapacity = 32768;
+    static constexpr int s_recordCapacity = 4096;
+};
+
+} // namespace KDHockeyApp
+
+int main(int argc, char *argv[])
+{
+    return KDHockeyApp::BenchLogFormat{argc, argv}.run();
+}
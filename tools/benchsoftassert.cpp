@@ -0,0 +1,115 @@
+#include "KDHockeyAppSoftAssert_p.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QVector>
+
+#include <limits>
+
+Q_LOGGING_CATEGORY(lcBenchSoftAssert, "kdhockeyapp.benchsoftassert")
+
+namespace KDHockeyApp {
+
+// Measures the cost of passing soft assertions in a tight loop, compared to the
+// same loop with a plain condition, and with no check at all. Passing assertions
+// must not cost more than the branch on their condition.
+class BenchSoftAssert : public QCoreApplication
+{
+public:
+    using QCoreApplication::QCoreApplication;
+
+    int run()
+    {
+        QCommandLineParser args;
+        args.addOption({"elements", "COUNT", "Number of elements per loop", "65536"});
+        args.addOption({"iterations", "COUNT", "Number of loops per measurement", "100"});
+        args.parse(arguments());
+
+        const auto elementCount = args.value("elements").toInt();
+        const auto iterations = args.value("iterations").toInt();
+
+        if (elementCount < 1 || iterations < 1)
+            return EXIT_FAILURE;
+
+        QVector<int> values(elementCount);
+
+        for (auto i = 0; i < elementCount; ++i)
+            values[i] = i & 1023; // never negative, the assertions pass
+
+        measure("no check", values, iterations, &sumWithoutCheck);
+        measure("plain condition", values, iterations, &sumWithCondition);
+        measure("KD_SOFTASSERT_FAILED", values, iterations, &sumWithSoftAssert);
+
+        return EXIT_SUCCESS;
+    }
+
+private:
+    using Function = qint64 (*)(const int *values, int count);
+
+    Q_DECL_NOINLINE static qint64 sumWithoutCheck(const int *values, int count)
+    {
+        qint64 sum = 0;
+
+        for (auto i = 0; i < count; ++i)
+            sum += values[i];
+
+        return sum;
+    }
+
+    Q_DECL_NOINLINE static qint64 sumWithCondition(const int *values, int count)
+    {
+        qint64 sum = 0;
+
+        for (auto i = 0; i < count; ++i) {
+            if (values[i] < 0)
+                continue;
+
+            sum += values[i];
+        }
+
+        return sum;
+    }
+
+    Q_DECL_NOINLINE static qint64 sumWithSoftAssert(const int *values, int count)
+    {
+        qint64 sum = 0;
+
+        for (auto i = 0; i < count; ++i) {
+            if (KD_SOFTASSERT_FAILED(lcBenchSoftAssert, values[i] >= 0))
+                continue;
+
+            sum += values[i];
+        }
+
+        return sum;
+    }
+
+    static void measure(const char *name, const QVector<int> &values, int iterations, Function function)
+    {
+        auto best = std::numeric_limits<double>::max();
+        qint64 sum = 0;
+
+        // the best of several rounds, to filter out preemption and frequency scaling
+        for (auto round = 0; round < s_roundCount; ++round) {
+            QElapsedTimer timer;
+            timer.start();
+
+            for (auto i = 0; i < iterations; ++i)
+                sum += function(values.constData(), values.count());
+
+            best = qMin(best, static_cast<double>(timer.nsecsElapsed()) / iterations / values.count());
+        }
+
+        qInfo("%-30s %8.3f ns per element (checksum %lld)", name, best, sum);
+    }
+
+    static constexpr int s_roundCount = 20;
+};
+
+} // namespace KDHockeyApp
+
+int main(int argc, char *argv[])
+{
+    return KDHockeyApp::BenchSoftAssert{argc, argv}.run();
+}
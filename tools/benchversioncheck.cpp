@@ -0,0 +1,282 @@
+#include "KDHockeyAppVersionChecker_p.h"
+
+#include <KDHockeyAppManager.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkAccessManager>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <QUrl>
+
+#include <algorithm>
+
+namespace KDHockeyApp {
+
+namespace {
+
+const QByteArray s_entityTag = "\"versions-1\"";
+
+} // namespace
+
+// Serves a fixed version list like HockeyApp does, including the ETag header,
+// and answers conditional requests for the same list with "304 Not Modified".
+class VersionServer : public QTcpServer
+{
+public:
+    explicit VersionServer(const QByteArray &json, QObject *parent = nullptr)
+        : QTcpServer{parent}
+        , m_json{json}
+    {
+        QObject::connect(this, &QTcpServer::newConnection, this, [this] {
+            while (const auto socket = nextPendingConnection()) {
+                QObject::connect(socket, &QTcpSocket::readyRead, this, [this, socket] { readRequest(socket); });
+                QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            }
+        });
+    }
+
+    QUrl url() const { return QUrl{"http://127.0.0.1:" + QString::number(serverPort()) + "/versions"}; }
+    int requestCount() const { return m_requestCount; }
+    qint64 bytesSent() const { return m_bytesSent; }
+
+private:
+    void readRequest(QTcpSocket *socket)
+    {
+        auto &buffer = m_buffers[socket];
+        buffer += socket->readAll();
+
+        if (!buffer.contains("\r\n\r\n"))
+            return;
+
+        const auto notModified = buffer.contains("If-None-Match: " + s_entityTag);
+        m_buffers.remove(socket);
+        ++m_requestCount;
+
+        QByteArray response;
+
+        if (notModified) {
+            response = "HTTP/1.1 304 Not Modified\r\nETag: " + s_entityTag + "\r\nConnection: close\r\n\r\n";
+        } else {
+            response = "HTTP/1.1 200 OK\r\nETag: " + s_entityTag
+                    + "\r\nContent-Type: application/json\r\nContent-Length: " + QByteArray::number(m_json.size())
+                    + "\r\nConnection: close\r\n\r\n" + m_json;
+        }
+
+        m_bytesSent += response.size();
+        socket->write(response);
+        socket->disconnectFromHost();
+    }
+
+    const QByteArray m_json;
+    QHash<QTcpSocket *, QByteArray> m_buffers;
+    int m_requestCount = 0;
+    qint64 m_bytesSent = 0;
+};
+
+// Compares the handling of version lists before and after VersionChecker got
+// introduced: Parsing, filtering and sorting a synthetic list of versions, and
+// the requests needed for repeated checks against a local stand-in server.
+class BenchVersionCheck : public QCoreApplication
+{
+public:
+    using QCoreApplication::QCoreApplication;
+
+    int run()
+    {
+        QCommandLineParser args;
+        args.addOption({"versions", "COUNT", "Number of versions in the list", "500"});
+        args.addOption({"iterations", "COUNT", "Number of times to process the list", "100"});
+        args.parse(arguments());
+
+        const auto versionCount = args.value("versions").toInt();
+        const auto iterations = args.value("iterations").toInt();
+
+        if (versionCount < 1 || iterations < 1)
+            return EXIT_FAILURE;
+
+        const auto json = createVersionList(versionCount);
+
+        // every version is newer, so that all of them get filtered and sorted
+        const QVersionNumber appVersion{0};
+        const QVersionNumber platformVersion{99};
+
+        measure("previous implementation", iterations, [&] {
+            return previousNewVersions(json, appVersion, platformVersion).count();
+        });
+
+        measure("VersionChecker", iterations, [&] {
+            return currentNewVersions(json, appVersion, platformVersion).count();
+        });
+
+        return measureRequests(json) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+private:
+    static QByteArray createVersionList(int count)
+    {
+        QJsonArray versions;
+
+        for (auto i = 0; i < count; ++i) {
+            // a scrambled order, as the server doesn't promise any
+            const auto build = (i * 7919) % count + 1;
+
+            versions.append(QJsonObject{
+                {"version", QString::number(build)},
+                {"shortversion", "1." + QString::number(build / 100) + "." + QString::number(build % 100)},
+                {"timestamp", 1500000000.0 + build * 3600.0},
+                {"appsize", 20000000 + build},
+                {"notes", "<p>Fixes and improvements of build " + QString::number(build) + "</p>"},
+                {"mandatory", build % 10 == 0},
+                {"minimum_os_version", "5.0"},
+            });
+        }
+
+        return QJsonDocument{versions}.toJson(QJsonDocument::Compact);
+    }
+
+    // findNewVersions() before VersionChecker got introduced
+    static QVariantList previousNewVersions(const QByteArray &json, const QVersionNumber &appVersion,
+                                            const QVersionNumber &actualPlatformVersion)
+    {
+        const auto versions = QJsonDocument::fromJson(json).array();
+        QVariantList newVersions;
+
+        for (const auto &value: versions) {
+            const auto entry = value.toObject();
+            const auto updateVersion = QVersionNumber::fromString(entry["version"].toString());
+            const auto largerVersionCode = updateVersion > appVersion;
+
+            const auto packageTimestamp = qRound64(entry["timestamp"].toDouble() * 1000);
+            const auto installTimestamp = QFileInfo{applicationFilePath()}.lastModified().toMSecsSinceEpoch();
+            const auto newerPackageFile = updateVersion == appVersion && packageTimestamp > installTimestamp;
+
+            const auto minimumPlatformVersion = QVersionNumber::fromString(entry["minimum_os_version"].toString());
+            const auto requirementsMet = minimumPlatformVersion <= actualPlatformVersion;
+
+            if ((largerVersionCode || newerPackageFile) && requirementsMet) {
+                const auto version = entry["shortversion"].toString();
+                const auto size = qRound64(entry["appsize"].toDouble());
+                const auto notes = entry["notes"].toString();
+                const auto mandatory = entry["mandatory"].toBool();
+
+                newVersions += QVariant::fromValue(HockeyAppVersionInfo{version, packageTimestamp, size, notes, mandatory});
+            }
+        }
+
+        // std::stable_sort, because std::sort may run out of bounds with this comparator,
+        // which is no strict weak ordering
+        std::stable_sort(newVersions.begin(), newVersions.end(), [](const QVariant &lhsVariant, const QVariant &rhsVariant) {
+            const auto lhs = lhsVariant.value<HockeyAppVersionInfo>();
+            const auto rhs = rhsVariant.value<HockeyAppVersionInfo>();
+
+            if (QVersionNumber::fromString(lhs.versionName) > QVersionNumber::fromString(rhs.versionName))
+                return true;
+
+            return lhs.timestamp > rhs.timestamp;
+        });
+
+        return newVersions;
+    }
+
+    // findNewVersions() with VersionChecker, for a list that was not cached yet
+    static QVariantList currentNewVersions(const QByteArray &json, const QVersionNumber &appVersion,
+                                           const QVersionNumber &actualPlatformVersion)
+    {
+        QString errorString;
+        const auto versions = VersionChecker::parse(json, &errorString);
+        const auto installTimestamp = QFileInfo{applicationFilePath()}.lastModified().toMSecsSinceEpoch();
+        QVariantList newVersions;
+
+        for (const auto &entry: versions) {
+            const auto largerVersionCode = entry.version > appVersion;
+            const auto newerPackageFile = entry.version == appVersion && entry.timestamp > installTimestamp;
+            const auto requirementsMet = entry.minimumPlatformVersion <= actualPlatformVersion;
+
+            if ((largerVersionCode || newerPackageFile) && requirementsMet) {
+                newVersions += QVariant::fromValue(HockeyAppVersionInfo{entry.versionName, entry.timestamp,
+                                                                        entry.size, entry.notes, entry.mandatory});
+            }
+        }
+
+        return newVersions;
+    }
+
+    template<typename Function>
+    static void measure(const char *name, int iterations, const Function &function)
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        auto count = 0;
+
+        for (auto i = 0; i < iterations; ++i)
+            count = function();
+
+        qInfo("%-30s %10.3f ms per check, %d new versions", name,
+              static_cast<double>(timer.nsecsElapsed()) / iterations / 1e6, count);
+    }
+
+    bool measureRequests(const QByteArray &json)
+    {
+        QTemporaryDir cacheDir;
+        VersionServer server{json};
+
+        if (!cacheDir.isValid() || !server.listen(QHostAddress::LocalHost)) {
+            qWarning("Could not prepare the benchmark environment");
+            return false;
+        }
+
+        QNetworkAccessManager network;
+        VersionChecker checker{cacheDir.filePath("versions.json")};
+
+        const auto check = [&](const char *name, qint64 refreshInterval) {
+            const auto requestCount = server.requestCount();
+            const auto bytesSent = server.bytesSent();
+            auto finished = false;
+
+            QElapsedTimer timer;
+            timer.start();
+
+            checker.setMinimumRefreshInterval(refreshInterval);
+            checker.check(&network, server.url(), this, [&finished](const QVector<VersionChecker::Version> &) {
+                finished = true;
+            });
+
+            QTimer timeout;
+            timeout.setSingleShot(true);
+            timeout.start(s_timeout);
+
+            while (!finished && timeout.isActive())
+                processEvents(QEventLoop::WaitForMoreEvents);
+
+            qInfo("%-30s %10.3f ms, %d requests, %lld bytes received%s", name,
+                  static_cast<double>(timer.nsecsElapsed()) / 1e6, server.requestCount() - requestCount,
+                  server.bytesSent() - bytesSent, finished ? "" : " (timed out)");
+
+            return finished;
+        };
+
+        return check("first check", 0)
+                && check("within refresh interval", s_refreshInterval)
+                && check("conditional request", 0);
+    }
+
+    static constexpr int s_refreshInterval = 15 * 60 * 1000;
+    static constexpr int s_timeout = 10000;
+};
+
+} // namespace KDHockeyApp
+
+int main(int argc, char *argv[])
+{
+    return KDHockeyApp::BenchVersionCheck{argc, argv}.run();
+}
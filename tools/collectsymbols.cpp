@@ -1,15 +1,375 @@
 #include <QCommandLineParser>
 #include <QCoreApplication>
+#include <QDateTime>
 #include <QDir>
-#include <QProcess>
-#include <QRegularExpression>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QTemporaryFile>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <QVector>
+#include <QtConcurrentRun>
+#include <QtEndian>
 
-#include <private/qzipwriter_p.h>
+#include <common/linux/dump_symbols.h>
+#include <common/linux/elfutils.h>
+#include <common/linux/file_id.h>
+#include <common/linux/memory_mapped_file.h>
 
+#include <algorithm>
+#include <cstring>
 #include <memory>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+#include <zlib.h>
 
 namespace KDHockeyApp {
 
+// Receives the symbols from Breakpad's dumper while they get written. The symbols are
+// compressed into raw deflate data for the archive right away, or stored unmodified for
+// compression level zero, and copied into the symbol cache if requested. Only the first
+// line is kept, as it names the module.
+class SymbolWriter : public std::streambuf
+{
+public:
+    SymbolWriter(QIODevice *target, int level, QIODevice *copy = nullptr)
+        : m_target{target}
+        , m_copy{copy}
+        , m_level{level}
+        , m_buffer{s_chunkSize, Qt::Uninitialized}
+    {
+        setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+
+        if (m_level > 0 && deflateInit2(&m_stream, m_level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            m_failed = true;
+    }
+
+    ~SymbolWriter() override
+    {
+        if (m_level > 0)
+            deflateEnd(&m_stream);
+    }
+
+    // Flushes all pending data. No more data can be written afterwards.
+    bool finish()
+    {
+        if (!flushBuffer())
+            return false;
+        if (m_level > 0 && !deflateChunk(nullptr, 0, Z_FINISH))
+            return false;
+
+        return !m_failed;
+    }
+
+    bool isCompressed() const { return m_level > 0; }
+    bool hasCopy() const { return m_copy != nullptr; }
+    quint32 crc() const { return static_cast<quint32>(m_crc); }
+    qint64 size() const { return m_size; }
+    QByteArray firstLine() const { return m_firstLine; }
+
+protected:
+    int_type overflow(int_type ch) override
+    {
+        if (!flushBuffer())
+            return traits_type::eof();
+
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+
+        return traits_type::not_eof(ch);
+    }
+
+    int sync() override
+    {
+        return flushBuffer() ? 0 : -1;
+    }
+
+private:
+    bool flushBuffer()
+    {
+        const auto size = static_cast<int>(pptr() - pbase());
+        setp(m_buffer.data(), m_buffer.data() + m_buffer.size());
+        return write(m_buffer.constData(), size);
+    }
+
+    bool write(const char *data, int size)
+    {
+        if (m_failed)
+            return false;
+
+        m_crc = crc32(m_crc, reinterpret_cast<const Bytef *>(data), static_cast<uInt>(size));
+        m_size += size;
+
+        if (!m_hasFirstLine) {
+            const auto end = static_cast<const char *>(memchr(data, '\n', static_cast<size_t>(size)));
+            const auto length = end ? static_cast<int>(end - data) : size;
+
+            m_firstLine.append(data, qMin(length, s_maximumLineLength - m_firstLine.size()));
+            m_hasFirstLine = end || m_firstLine.size() >= s_maximumLineLength;
+        }
+
+        // the symbols are complete without cache, therefore failing to copy is no error
+        if (m_copy && m_copy->write(data, size) != size) {
+            qWarning("Could not copy symbols into the cache: %ls", qUtf16Printable(m_copy->errorString()));
+            m_copy = nullptr;
+        }
+
+        if (m_level == 0) {
+            if (m_target->write(data, size) == size)
+                return true;
+
+            m_failed = true;
+            return false;
+        }
+
+        return deflateChunk(data, size, Z_NO_FLUSH);
+    }
+
+    bool deflateChunk(const char *data, int size, int flush)
+    {
+        char buffer[s_chunkSize];
+
+        m_stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+        m_stream.avail_in = static_cast<uInt>(size);
+
+        do {
+            m_stream.next_out = reinterpret_cast<Bytef *>(buffer);
+            m_stream.avail_out = sizeof buffer;
+
+            if (deflate(&m_stream, flush) == Z_STREAM_ERROR) {
+                m_failed = true;
+                return false;
+            }
+
+            const auto produced = static_cast<qint64>(sizeof buffer - m_stream.avail_out);
+
+            if (m_target->write(buffer, produced) != produced) {
+                m_failed = true;
+                return false;
+            }
+        } while (m_stream.avail_out == 0);
+
+        return true;
+    }
+
+    static constexpr int s_chunkSize = 65536;
+    static constexpr int s_maximumLineLength = 4096;
+
+    QIODevice *const m_target;
+    QIODevice *m_copy;
+    const int m_level;
+    QByteArray m_buffer;
+    QByteArray m_firstLine;
+    z_stream m_stream = {};
+    uLong m_crc = 0;
+    qint64 m_size = 0;
+    bool m_hasFirstLine = false;
+    bool m_failed = false;
+};
+
+// Writes zip archives from entries which got compressed beforehand, like by SymbolWriter.
+// Their data is copied in chunks, so that memory use does not depend on the entries' size.
+// All entries carry the same timestamp, which keeps the archives identical between builds.
+// The archive only replaces the file once it got committed.
+class ZipWriter
+{
+public:
+    explicit ZipWriter(const QString &fileName)
+        : m_file{fileName}
+    {}
+
+    bool open()
+    {
+        return m_file.open(QFile::WriteOnly);
+    }
+
+    QString errorString() const
+    {
+        return m_errorString.isEmpty() ? m_file.errorString() : m_errorString;
+    }
+
+    bool addDirectory(const QString &name)
+    {
+        Entry entry;
+        entry.name = name.toUtf8() + '/';
+        entry.attributes = s_directoryAttributes;
+
+        return writeLocalHeader(&entry);
+    }
+
+    bool addFile(const QString &name, QIODevice *data, quint32 crc, qint64 size, bool compressed)
+    {
+        Entry entry;
+        entry.name = name.toUtf8();
+        entry.attributes = s_fileAttributes;
+        entry.crc = crc;
+
+        if (compressed)
+            entry.method = s_methodDeflated;
+
+        if (!checkLimit(size) || !checkLimit(data->size()))
+            return false;
+
+        entry.size = static_cast<quint32>(size);
+        entry.compressedSize = static_cast<quint32>(data->size());
+
+        if (!writeLocalHeader(&entry))
+            return false;
+
+        char buffer[s_chunkSize];
+
+        for (qint64 remaining = entry.compressedSize; remaining > 0; ) {
+            const auto chunk = data->read(buffer, qMin<qint64>(remaining, sizeof buffer));
+
+            if (chunk <= 0) {
+                m_errorString = data->errorString();
+                return false;
+            }
+
+            if (m_file.write(buffer, chunk) != chunk)
+                return false;
+
+            remaining -= chunk;
+        }
+
+        return true;
+    }
+
+    // Writes the central directory, and replaces the archive file.
+    bool commit()
+    {
+        const auto directoryOffset = m_file.pos();
+        QByteArray directory;
+
+        for (const auto &entry: m_entries) {
+            appendLittleEndian<quint32>(&directory, s_centralHeaderSignature);
+            appendLittleEndian<quint16>(&directory, s_versionMadeBy);
+            appendLittleEndian<quint16>(&directory, s_versionNeeded);
+            appendCommonHeader(&directory, entry);
+            appendLittleEndian<quint16>(&directory, 0); // comment length
+            appendLittleEndian<quint16>(&directory, 0); // disk number
+            appendLittleEndian<quint16>(&directory, 0); // internal attributes
+            appendLittleEndian<quint32>(&directory, entry.attributes);
+            appendLittleEndian<quint32>(&directory, entry.offset);
+            directory += entry.name;
+        }
+
+        const auto directorySize = directory.size();
+
+        if (!checkLimit(directoryOffset) || !checkLimit(directoryOffset + directorySize))
+            return false;
+
+        appendLittleEndian<quint32>(&directory, s_endOfDirectorySignature);
+        appendLittleEndian<quint16>(&directory, 0); // this disk
+        appendLittleEndian<quint16>(&directory, 0); // disk with the central directory
+        appendLittleEndian<quint16>(&directory, static_cast<quint16>(m_entries.size()));
+        appendLittleEndian<quint16>(&directory, static_cast<quint16>(m_entries.size()));
+        appendLittleEndian<quint32>(&directory, static_cast<quint32>(directorySize));
+        appendLittleEndian<quint32>(&directory, static_cast<quint32>(directoryOffset));
+        appendLittleEndian<quint16>(&directory, 0); // comment length
+
+        return m_file.write(directory) == directory.size() && m_file.commit();
+    }
+
+private:
+    struct Entry
+    {
+        QByteArray name;
+        quint32 attributes = 0;
+        quint32 crc = 0;
+        quint32 size = 0;
+        quint32 compressedSize = 0;
+        quint32 offset = 0;
+        quint16 method = s_methodStored;
+    };
+
+    template<typename T>
+    static void appendLittleEndian(QByteArray *data, T value)
+    {
+        const auto encoded = qToLittleEndian(value);
+        data->append(reinterpret_cast<const char *>(&encoded), sizeof encoded);
+    }
+
+    // the fields shared by local and central headers, starting at the general purpose flags
+    static void appendCommonHeader(QByteArray *header, const Entry &entry)
+    {
+        appendLittleEndian<quint16>(header, s_flagUtf8);
+        appendLittleEndian<quint16>(header, entry.method);
+        appendLittleEndian<quint16>(header, s_dosTime);
+        appendLittleEndian<quint16>(header, s_dosDate);
+        appendLittleEndian<quint32>(header, entry.crc);
+        appendLittleEndian<quint32>(header, entry.compressedSize);
+        appendLittleEndian<quint32>(header, entry.size);
+        appendLittleEndian<quint16>(header, static_cast<quint16>(entry.name.size()));
+        appendLittleEndian<quint16>(header, 0); // extra field length
+    }
+
+    bool writeLocalHeader(Entry *entry)
+    {
+        if (m_entries.size() >= s_maximumEntries) {
+            m_errorString = QStringLiteral("Too many entries for the zip format");
+            return false;
+        }
+
+        if (!checkLimit(m_file.pos()))
+            return false;
+
+        entry->offset = static_cast<quint32>(m_file.pos());
+
+        QByteArray header;
+        appendLittleEndian<quint32>(&header, s_localHeaderSignature);
+        appendLittleEndian<quint16>(&header, s_versionNeeded);
+        appendCommonHeader(&header, *entry);
+        header += entry->name;
+
+        if (m_file.write(header) != header.size())
+            return false;
+
+        m_entries.append(*entry);
+        return true;
+    }
+
+    // this writer does not implement the Zip64 extensions
+    bool checkLimit(qint64 value)
+    {
+        if (value >= 0 && value < s_maximumSize)
+            return true;
+
+        m_errorString = QStringLiteral("The archive exceeds the size limits of the zip format");
+        return false;
+    }
+
+    static constexpr int s_chunkSize = 65536;
+    static constexpr int s_maximumEntries = 0xffff;
+    static constexpr qint64 s_maximumSize = 0xffffffff;
+    static constexpr quint32 s_localHeaderSignature = 0x04034b50;
+    static constexpr quint32 s_centralHeaderSignature = 0x02014b50;
+    static constexpr quint32 s_endOfDirectorySignature = 0x06054b50;
+    static constexpr quint16 s_versionMadeBy = 0x0314; // Unix, version 2.0
+    static constexpr quint16 s_versionNeeded = 20;
+    static constexpr quint16 s_flagUtf8 = 0x0800;
+    static constexpr quint16 s_methodStored = 0;
+    static constexpr quint16 s_methodDeflated = 8;
+    static constexpr quint16 s_dosTime = 0;
+    static constexpr quint16 s_dosDate = (1 << 5) | 1; // 1980-01-01, the earliest date
+    static constexpr quint32 s_fileAttributes = 0100644u << 16;
+    static constexpr quint32 s_directoryAttributes = (040755u << 16) | 0x10;
+
+    QSaveFile m_file;
+    QString m_errorString;
+    QVector<Entry> m_entries;
+};
+
 class CollectSymbols : public QCoreApplication
 {
 public:
@@ -18,160 +378,650 @@ public:
     int run()
     {
         QCommandLineParser args;
-        args.addOption({"dumpsyms", "PATH", " The machine specific dumpsyms binary to use"});
-        args.addOption({"readelf", "PATH", " The machine specific readelf binary to use"});
         args.addOption({"library-path", "PATH", " Directories of where to find shared libraries"});
+        args.addOption({"plugin", "PATH", " Additional modules loaded at runtime, like Qt plugins"});
+        args.addOption({"jobs", "COUNT", " Number of modules to dump in parallel, defaults to the number of cores"});
+        args.addOption({"cache", "PATH", " Directory where to keep the symbols of modules by their build-id"});
+        args.addOption({"cache-size", "MIB", " Maximum size of the symbol cache, zero disables it", "1024"});
+        args.addOption({"compression-level", "LEVEL", " From 1 for the fastest to 9 for the smallest archive, zero stores the symbols uncompressed", "6"});
+        args.addOption({"list-dependencies", " Only resolve the modules to dump, and print them with the time this took"});
         args.addPositionalArgument("TARGET", "The file from which to collect symbols");
         args.parse(arguments());
 
         const auto pargs = args.positionalArguments();
+        const auto listDependencies = args.isSet("list-dependencies");
 
-        if (pargs.size() != 2)
+        if (pargs.size() != (listDependencies ? 1 : 2))
             return EXIT_FAILURE;
 
-        m_dumpSyms = args.value("dumpsyms");
-        m_readElf = args.value("readelf");
+        m_libraryPath = args.values("library-path");
+        m_maximumJobs = args.isSet("jobs") ? args.value("jobs").toInt() : QThread::idealThreadCount();
 
-        if (m_dumpSyms.isEmpty())
-            m_dumpSyms= "dump_syms";
-        if (m_readElf.isEmpty())
-            m_readElf = "readelf";
+        m_compressionLevel = args.value("compression-level").toInt();
 
-        m_libraryPath = args.values("library-path");
+        if (m_maximumJobs < 1 || m_compressionLevel < 0 || m_compressionLevel > 9)
+            return EXIT_FAILURE;
+
+        m_workers.setMaxThreadCount(m_maximumJobs);
+        m_cacheLimit = args.value("cache-size").toLongLong() * 1024 * 1024;
+
+        if (m_cacheLimit > 0) {
+            if (args.isSet("cache"))
+                m_cacheDir.setPath(args.value("cache"));
+            else
+                m_cacheDir.setPath(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/KDHockeyApp/symbols");
+
+            if (!m_cacheDir.mkpath(".")) {
+                qWarning("Could not create the symbol cache in %ls", qUtf16Printable(m_cacheDir.path()));
+                m_cacheLimit = 0;
+            }
+        }
 
         if (m_libraryPath.isEmpty()) {
 #ifdef Q_OS_WIN32
             m_libraryPath = QString::fromLocal8Bit(qgetenv("PATH")).split(QDir::listSeparator());
 #else
+            // without explicit library path this host's libraries get collected, search them like ld.so
             m_libraryPath = QString::fromLocal8Bit(qgetenv("LD_LIBRARY_PATH")).split(QDir::listSeparator());
+            m_systemLibraryPath = readLinkerConfig("/etc/ld.so.conf");
+            m_systemLibraryPath += QStringList{"/lib64", "/usr/lib64", "/lib", "/usr/lib"};
 #endif
         }
 
         const auto target = pargs.at(0);
+
+        if (listDependencies)
+            return printDependencies(target, args.values("plugin"));
+
         const auto archive = pargs.at(1);
 
         if (!archive.endsWith(".zip"))
             return EXIT_FAILURE;
 
-        m_workDir = archive.left(archive.length() - 4);
-        m_workDir.removeRecursively();
+        m_zipWriter = std::make_unique<ZipWriter>(archive);
 
-        if (!m_workDir.mkpath(".")) {
-            qWarning("Could not create work directory");
+        if (!m_zipWriter->open()) {
+            qWarning("Could not create %ls: %ls", qUtf16Printable(archive), qUtf16Printable(m_zipWriter->errorString()));
             return EXIT_FAILURE;
         }
 
-        m_zipWriter = std::make_unique<QZipWriter>(archive);
-
-        if (!dumpSymbols(target))
+        if (!resolveDependencies(target, args.values("plugin")) || !dumpSymbols())
             return EXIT_FAILURE;
 
-        const auto dependencyList = dependencies(target);
-        if (!dependencyList.first)
+        if (!m_zipWriter->commit()) {
+            qWarning("Could not write %ls: %ls", qUtf16Printable(archive), qUtf16Printable(m_zipWriter->errorString()));
             return EXIT_FAILURE;
-
-        for (const auto &libraryName: dependencyList.second) {
-            if (!dumpSymbols(findLibrary(libraryName)))
-                return EXIT_FAILURE;
         }
 
         return EXIT_SUCCESS;
     }
 
 private:
-    std::pair<bool, QStringList> dependencies(const QString &fileName)
+    struct ElfInfo
     {
-        QProcess readElf;
-        readElf.setReadChannel(QProcess::StandardOutput);
-        readElf.start(m_readElf, {"-d", fileName});
+        bool isValid = false;
+        int elfClass = 0;
+        int machine = 0;
+        QStringList needed;
+        QStringList rpath;
+        QStringList runpath;
+    };
 
-        if (!readElf.waitForReadyRead()) {
-            qWarning("Could not run readelf: %ls", qUtf16Printable(readElf.errorString()));
-            return {};
-        }
+    // Walks the dependency graph of the target and its plugins once, and queues a job for
+    // each module found. Libraries are searched like ld.so(8) does: In the RPATH of the
+    // loading objects unless the loader has RUNPATH, in the library path, in RUNPATH, and
+    // finally in the directories of ld.so.conf and the default directories. Plugins get
+    // loaded by the target, and therefore inherit its RPATH.
+    bool resolveDependencies(const QString &target, const QStringList &plugins)
+    {
+        struct Module
+        {
+            QString fileName;
+            QStringList loaderRpath;
+        };
+
+        QVector<Module> modules;
+        QSet<QString> knownModules;
+
+        const auto addModule = [&modules, &knownModules](const QString &fileName, const QStringList &loaderRpath) {
+            const auto canonicalFileName = QFileInfo{fileName}.canonicalFilePath();
 
-        QRegularExpression pattern{".*\\(NEEDED\\).*\\[(.*)\\]"};
-        QStringList dependencies;
+            if (knownModules.contains(canonicalFileName))
+                return;
 
-        while (!readElf.atEnd()) {
-            const auto line = QString::fromLocal8Bit(readElf.readLine());
-            const auto test = pattern.match(line);
+            knownModules.insert(canonicalFileName);
+            modules.append({fileName, loaderRpath});
+        };
 
-            if (test.hasMatch())
-                dependencies.append(test.captured(1));
+        addModule(target, {});
+
+        for (auto i = 0; i < modules.size(); ++i) {
+            const auto module = modules.at(i);
+            const auto info = elfInfo(module.fileName);
+
+            if (!info.isValid) {
+                qWarning("Could not read ELF file %ls", qUtf16Printable(module.fileName));
+                return false;
+            }
+
+            m_jobs.emplace_back();
+            m_jobs.back().module.setFile(module.fileName);
+
+            const auto origin = QFileInfo{module.fileName}.canonicalPath();
+            const auto rpath = info.runpath.isEmpty() ? expandOrigin(info.rpath, origin) + module.loaderRpath
+                                                      : module.loaderRpath;
+            const auto searchPath = (info.runpath.isEmpty() ? rpath : QStringList{})
+                    + m_libraryPath + expandOrigin(info.runpath, origin) + m_systemLibraryPath;
+
+            for (const auto &libraryName: info.needed) {
+                const auto fileName = findLibrary(libraryName, searchPath, info);
+
+                if (fileName.isEmpty()) {
+                    qWarning("Could not find %ls needed by %ls, skipping its symbols",
+                             qUtf16Printable(libraryName), qUtf16Printable(module.fileName));
+                    continue;
+                }
+
+                addModule(fileName, rpath);
+            }
+
+            if (i == 0) {
+                for (const auto &fileName: plugins)
+                    addModule(fileName, rpath);
+            }
         }
 
-        if (!readElf.waitForFinished())
-            return {};
+        return true;
+    }
+
+    // Measures the dependency walk, e.g. of large applications, without dumping any symbols.
+    int printDependencies(const QString &target, const QStringList &plugins)
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        if (!resolveDependencies(target, plugins))
+            return EXIT_FAILURE;
+
+        const auto elapsed = timer.nsecsElapsed();
+
+        for (const auto &job: m_jobs)
+            qInfo("%ls", qUtf16Printable(job.module.filePath()));
 
-        return {true, dependencies};
+        qInfo("%d modules, %d directory listings, %.2f ms", static_cast<int>(m_jobs.size()),
+              m_directoryEntries.size(), static_cast<double>(elapsed) / 1e6);
+
+        return EXIT_SUCCESS;
     }
 
-    QString findLibrary(const QString &libraryName)
+    // Returns the first library of that name in the search path, which matches the
+    // loading object's ELF class and machine. Names with slashes are used as they are.
+    QString findLibrary(const QString &libraryName, const QStringList &searchPath, const ElfInfo &loader)
     {
-        for (const QDir path: m_libraryPath) {
-            const auto fileName = path.filePath(libraryName);
-            if (QFile::exists(fileName))
+        const auto isCompatible = [this, &loader](const QString &fileName) {
+            const auto info = elfInfo(fileName);
+            return info.isValid && info.elfClass == loader.elfClass && info.machine == loader.machine;
+        };
+
+        if (libraryName.contains('/'))
+            return isCompatible(libraryName) ? libraryName : QString{};
+
+        for (const auto &path: searchPath) {
+            if (path.isEmpty() || !directoryEntries(path).contains(libraryName))
+                continue;
+
+            const auto fileName = path + "/" + libraryName;
+
+            if (isCompatible(fileName))
                 return fileName;
         }
 
-        return libraryName;
+        return {};
     }
 
-    bool dumpSymbols(const QFileInfo &fileInfo)
+    // Big dependency graphs probe the same few directories for many libraries,
+    // therefore each directory only gets listed once.
+    QSet<QString> directoryEntries(const QString &path)
     {
-        const QFileInfo symbolFileInfo{m_workDir.filePath(fileInfo.baseName() + ".sym")};
+        auto it = m_directoryEntries.find(path);
 
-        QProcess dumpSyms;
-        dumpSyms.setStandardOutputFile(symbolFileInfo.filePath());
-        dumpSyms.start(m_dumpSyms, {"-v", fileInfo.filePath()});
+        if (it == m_directoryEntries.end()) {
+            QSet<QString> entries;
 
-        if (!dumpSyms.waitForFinished()) {
-            qWarning("Could not run dumpsyms: %ls", qUtf16Printable(dumpSyms.errorString()));
-            return false;
+            for (const auto &fileName: QDir{path}.entryList(QDir::Files))
+                entries.insert(fileName);
+
+            it = m_directoryEntries.insert(path, entries);
+        }
+
+        return it.value();
+    }
+
+    ElfInfo elfInfo(const QString &fileName)
+    {
+        auto it = m_elfInfos.find(fileName);
+
+        if (it == m_elfInfos.end())
+            it = m_elfInfos.insert(fileName, readElfInfo(fileName));
+
+        return it.value();
+    }
+
+    // Reads the ELF header and the dynamic section of the mapped file.
+    // Static executables have no dynamic section, and therefore no dependencies.
+    static ElfInfo readElfInfo(const QString &fileName)
+    {
+        const google_breakpad::MemoryMappedFile file{QFile::encodeName(fileName).constData(), 0};
+        ElfInfo info;
+
+        if (!file.data() || file.size() < s_elfHeaderSize || !google_breakpad::IsValidElf(file.data()))
+            return info;
+
+        const auto header = static_cast<const char *>(file.data());
+        quint16 machine;
+        memcpy(&machine, header + s_elfMachineOffset, sizeof machine);
+
+        info.isValid = true;
+        info.elfClass = header[EI_CLASS];
+        info.machine = machine;
+
+        const void *dynamic, *strings;
+        size_t dynamicSize, stringsSize;
+
+        if (!google_breakpad::FindElfSection(file.data(), ".dynamic", SHT_DYNAMIC, &dynamic, &dynamicSize))
+            return info;
+
+        if (!google_breakpad::FindElfSection(file.data(), ".dynstr", SHT_STRTAB, &strings, &stringsSize)) {
+            qWarning("Could not find the dynamic string table of %ls", qUtf16Printable(fileName));
+            return info;
         }
 
-        dumpSyms.close();
+        const auto entries = info.elfClass == ELFCLASS64
+                ? dynamicEntries<quint64>(dynamic, dynamicSize)
+                : dynamicEntries<quint32>(dynamic, dynamicSize);
 
-        const auto symbolDir = "symbols/" + fileInfo.fileName() + "/" + moduleVersion(symbolFileInfo.filePath());
-        const auto symbolFileName = symbolDir + "/" + symbolFileInfo.fileName();
+        for (const auto &entry: entries) {
+            if (entry.second >= stringsSize)
+                continue;
 
-        QFile symbolFile{symbolFileInfo.filePath()};
+            const auto text = static_cast<const char *>(strings) + entry.second;
+            const auto length = qstrnlen(text, static_cast<uint>(stringsSize - entry.second));
+            const auto value = QFile::decodeName(QByteArray{text, static_cast<int>(length)});
 
-        if (!symbolFile.open(QFile::ReadOnly)) {
-            qWarning("Could not open %ls: %ls", qUtf16Printable(symbolFileName), qUtf16Printable(symbolFile.errorString()));
-            return false;
+            if (entry.first == s_dynamicNeeded)
+                info.needed.append(value);
+            else if (entry.first == s_dynamicRpath)
+                info.rpath = value.split(':', QString::SkipEmptyParts);
+            else if (entry.first == s_dynamicRunpath)
+                info.runpath = value.split(':', QString::SkipEmptyParts);
         }
 
-        m_zipWriter->addDirectory(symbolDir);
-        m_zipWriter->addFile(symbolFileName, &symbolFile);
+        return info;
+    }
 
-        return true;
+    // the entries of a dynamic section are pairs of tag and value, sized like the ELF class' words
+    template<typename Word>
+    static QVector<QPair<quint64, quint64>> dynamicEntries(const void *section, size_t size)
+    {
+        QVector<QPair<quint64, quint64>> entries;
+
+        for (size_t offset = 0; offset + 2 * sizeof(Word) <= size; offset += 2 * sizeof(Word)) {
+            Word entry[2];
+            memcpy(entry, static_cast<const char *>(section) + offset, sizeof entry);
+
+            if (entry[0] == s_dynamicNull)
+                break;
+
+            entries.append({entry[0], entry[1]});
+        }
+
+        return entries;
+    }
+
+    static QStringList expandOrigin(QStringList paths, const QString &origin)
+    {
+        for (auto &path: paths) {
+            path.replace("${ORIGIN}", origin);
+            path.replace("$ORIGIN", origin);
+        }
+
+        return paths;
     }
 
-    QString moduleVersion(const QString &fileName)
+    // Reads the library directories from ld.so's configuration, following its includes.
+    static QStringList readLinkerConfig(const QString &fileName)
     {
         QFile file{fileName};
+        QStringList libraryPath;
+
+        if (!file.open(QFile::ReadOnly))
+            return libraryPath;
+
+        while (!file.atEnd()) {
+            const auto line = QString::fromLocal8Bit(file.readLine()).section('#', 0, 0).trimmed();
+
+            if (line.startsWith("include ")) {
+                const QFileInfo pattern{QFileInfo{fileName}.dir(), line.mid(8).trimmed()};
+
+                for (const auto &include: pattern.dir().entryInfoList({pattern.fileName()}, QDir::Files, QDir::Name))
+                    libraryPath += readLinkerConfig(include.filePath());
+            } else if (!line.isEmpty()) {
+                libraryPath.append(line);
+            }
+        }
+
+        return libraryPath;
+    }
+
+    struct DumpResult
+    {
+        QString dataFileName;
+        QByteArray moduleLine;
+        quint32 crc = 0;
+        qint64 size = 0;
+        qint64 elapsed = 0;
+        bool compressed = false;
+        bool succeeded = false;
+        bool cached = false;
+    };
+
+    struct DumpJob
+    {
+        QFileInfo module;
+        DumpResult result;
+        bool finished = false;
+    };
+
+    // Dumps up to m_maximumJobs modules at once on the worker threads. Their symbols get added
+    // to the archive in module order as soon as all preceding modules are done, which keeps the
+    // archive identical between runs, no matter which module finishes first. Symbols waiting
+    // for a slow module are kept in temporary files, jobs only start within a bounded window.
+    bool dumpSymbols()
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        QTimer::singleShot(0, this, [this] { startJobs(); });
+        exec();
+
+        qInfo("Collected symbols of %d modules in %lld ms using %d jobs",
+              m_archivedJobs, timer.elapsed(), m_maximumJobs);
+
+        // after failures some symbols never got archived
+        for (const auto &job: m_jobs) {
+            if (!job.result.dataFileName.isEmpty())
+                QFile::remove(job.result.dataFileName);
+        }
+
+        if (m_cacheLimit > 0)
+            evictSymbolCache();
+
+        return !m_failed;
+    }
+
+    void startJobs()
+    {
+        while (!m_failed && m_runningJobs < m_maximumJobs
+               && m_startedJobs - m_archivedJobs < 2 * m_maximumJobs
+               && m_startedJobs < static_cast<int>(m_jobs.size()))
+            startJob(m_startedJobs++);
+
+        if (m_runningJobs == 0)
+            quit();
+    }
+
+    void startJob(int index)
+    {
+        const auto watcher = new QFutureWatcher<DumpResult>{this};
+
+        QObject::connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, index] {
+            watcher->deleteLater();
+            finishJob(index, watcher->result());
+        });
+
+        ++m_runningJobs;
+        watcher->setFuture(QtConcurrent::run(&m_workers, &CollectSymbols::writeSymbols,
+                                             m_jobs[static_cast<size_t>(index)].module.filePath(),
+                                             m_cacheLimit > 0 ? m_cacheDir.absolutePath() : QString{},
+                                             m_compressionLevel));
+    }
+
+    // NOTICE: This runs on the worker threads. The symbols get compressed into a temporary
+    // file while they are written, so that no symbol file is ever held in memory as whole.
+    static DumpResult writeSymbols(const QString &fileName, const QString &cachePath, int compressionLevel)
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        DumpResult result;
+        QTemporaryFile dataFile{QDir::temp().filePath("collectsymbols-XXXXXX.dat")};
+        dataFile.setAutoRemove(false);
+
+        if (!dataFile.open()) {
+            qWarning("Could not create temporary file: %ls", qUtf16Printable(dataFile.errorString()));
+            return result;
+        }
+
+        result.dataFileName = dataFile.fileName();
+
+        const auto takeResult = [&result](const SymbolWriter &writer) {
+            result.moduleLine = writer.firstLine();
+            result.crc = writer.crc();
+            result.size = writer.size();
+            result.compressed = writer.isCompressed();
+        };
+
+        const auto cacheFileName = cachePath.isEmpty() ? QString{} : symbolCacheFileName(cachePath, fileName);
+        QFile cacheFile{cacheFileName};
+
+        if (!cacheFileName.isEmpty() && cacheFile.open(QFile::ReadOnly)) {
+            SymbolWriter writer{&dataFile, compressionLevel};
+            QByteArray buffer{s_chunkSize, Qt::Uninitialized};
+            qint64 size;
+
+            while ((size = cacheFile.read(buffer.data(), buffer.size())) > 0)
+                writer.sputn(buffer.constData(), size);
+
+            result.succeeded = result.cached = size == 0 && writer.finish() && writer.size() > 0;
+            takeResult(writer);
+
+            // the modification time tells which symbols were used least recently when evicting
+            cacheFile.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+        }
+
+        if (!result.cached) {
+            dataFile.resize(0);
+            dataFile.seek(0);
+
+            // concurrent runs of this tool may share the cache, therefore entries only appear once complete
+            QSaveFile cacheCopy{cacheFileName};
+            const auto caching = !cacheFileName.isEmpty()
+                    && QDir{}.mkpath(QFileInfo{cacheFileName}.path())
+                    && cacheCopy.open(QFile::WriteOnly);
+
+            SymbolWriter writer{&dataFile, compressionLevel, caching ? &cacheCopy : nullptr};
+            std::ostream stream{&writer};
+
+            const google_breakpad::DumpOptions options{ALL_SYMBOL_DATA, true};
+            result.succeeded = google_breakpad::WriteSymbolFile(QFile::encodeName(fileName).toStdString(), {}, options, stream)
+                    && writer.finish();
+            takeResult(writer);
+
+            if (caching) {
+                if (!result.succeeded || !writer.hasCopy())
+                    cacheCopy.cancelWriting();
+                else if (!cacheCopy.commit())
+                    qWarning("Could not store %ls: %ls", qUtf16Printable(cacheFileName), qUtf16Printable(cacheCopy.errorString()));
+            }
+        }
+
+        if (!result.succeeded) {
+            qWarning("Could not dump symbols of %ls", qUtf16Printable(fileName));
+            QFile::remove(result.dataFileName);
+            result.dataFileName.clear();
+        }
+
+        result.elapsed = timer.elapsed();
+        return result;
+    }
+
+    // Returns where to cache the symbols of a module. The build-id identifies the module's
+    // content, but its symbols also carry the file name. Modules without build-id cannot be
+    // cached: Breakpad's fallback identifier only hashes the beginning of their code.
+    static QString symbolCacheFileName(const QString &cachePath, const QString &fileName)
+    {
+        const google_breakpad::MemoryMappedFile file{QFile::encodeName(fileName).constData(), 0};
+        const void *buildId;
+        size_t buildIdSize;
+
+        if (!file.data() || !google_breakpad::FindElfSection(file.data(), ".note.gnu.build-id", SHT_NOTE, &buildId, &buildIdSize))
+            return {};
+
+        google_breakpad::PageAllocator allocator;
+        google_breakpad::auto_wasteful_vector<uint8_t, google_breakpad::kDefaultBuildIdSize> identifier{&allocator};
 
-        if (!file.open(QFile::ReadOnly)) {
-            qWarning("Could not open %ls: %ls", qUtf16Printable(fileName), qUtf16Printable(file.errorString()));
+        if (!google_breakpad::FileID::ElfFileIdentifierFromMappedFile(file.data(), identifier))
             return {};
+
+        const auto key = QString::fromStdString(google_breakpad::FileID::ConvertIdentifierToString(identifier));
+        return cachePath + "/" + key + "/" + QFileInfo{fileName}.fileName() + ".sym";
+    }
+
+    // Removes the least recently used symbols until the cache fits into its size limit.
+    void evictSymbolCache()
+    {
+        QFileInfoList entries;
+        qint64 cacheSize = 0;
+
+        for (QDirIterator it{m_cacheDir.path(), {"*.sym"}, QDir::Files, QDirIterator::Subdirectories}; it.hasNext(); ) {
+            entries.append(QFileInfo{it.next()});
+            cacheSize += entries.last().size();
         }
 
-        while (!file.atEnd()) {
-            const auto line = file.readLine().split(' ');
-            if (line.length() >= 4 && line[0] == "MODULE")
-                return QString::fromUtf8(line[3]);
+        std::sort(entries.begin(), entries.end(), [](const QFileInfo &lhs, const QFileInfo &rhs) {
+            return lhs.lastModified() < rhs.lastModified();
+        });
+
+        auto evicted = 0;
+
+        for (const auto &entry: entries) {
+            if (cacheSize <= m_cacheLimit)
+                break;
+
+            if (!QFile::remove(entry.filePath()))
+                continue;
+
+            m_cacheDir.rmdir(entry.dir().dirName()); // only succeeds for directories left empty
+            cacheSize -= entry.size();
+            ++evicted;
+        }
+
+        qInfo("Symbol cache: %d hits, %d misses, %d evicted, %lld of %lld MiB used",
+              m_cacheHits, m_cacheMisses, evicted, cacheSize / 1024 / 1024, m_cacheLimit / 1024 / 1024);
+    }
+
+    void finishJob(int index, const DumpResult &result)
+    {
+        auto &job = m_jobs[static_cast<size_t>(index)];
+
+        job.result = result;
+        job.finished = true;
+
+        if (result.cached)
+            ++m_cacheHits;
+        else if (m_cacheLimit > 0)
+            ++m_cacheMisses;
+
+        --m_runningJobs;
+
+        if (!result.succeeded)
+            m_failed = true;
+
+        for (; m_archivedJobs < m_startedJobs && m_jobs[static_cast<size_t>(m_archivedJobs)].finished; ++m_archivedJobs) {
+            if (!archiveSymbols(&m_jobs[static_cast<size_t>(m_archivedJobs)])) {
+                m_failed = true;
+                break;
+            }
+        }
+
+        startJobs();
+    }
+
+    bool archiveSymbols(DumpJob *job)
+    {
+        if (!job->result.succeeded)
+            return false;
+
+        const auto version = moduleVersion(job->result.moduleLine);
+
+        if (version.isEmpty()) {
+            qWarning("Could not find the module version of %ls", qUtf16Printable(job->module.filePath()));
+            return false;
+        }
+
+        const auto symbolDir = "symbols/" + job->module.fileName() + "/" + version;
+        const auto symbolFileName = symbolDir + "/" + job->module.baseName() + ".sym";
+
+        QFile data{job->result.dataFileName};
+
+        if (!data.open(QFile::ReadOnly)) {
+            qWarning("Could not open %ls: %ls", qUtf16Printable(data.fileName()), qUtf16Printable(data.errorString()));
+            return false;
         }
 
+        const auto archived = m_zipWriter->addDirectory(symbolDir)
+                && m_zipWriter->addFile(symbolFileName, &data, job->result.crc, job->result.size, job->result.compressed);
+
+        data.remove();
+        job->result.dataFileName.clear();
+
+        if (!archived) {
+            qWarning("Could not archive %ls: %ls", qUtf16Printable(symbolFileName), qUtf16Printable(m_zipWriter->errorString()));
+            return false;
+        }
+
+        qInfo("%8lld ms  %ls%s", job->result.elapsed, qUtf16Printable(job->module.fileName()),
+              job->result.cached ? " (cached)" : "");
+
+        return true;
+    }
+
+    // the symbol file starts with "MODULE operatingsystem architecture id name"
+    static QString moduleVersion(const QByteArray &moduleLine)
+    {
+        const auto line = moduleLine.split(' ');
+
+        if (line.length() >= 4 && line[0] == "MODULE")
+            return QString::fromUtf8(line[3]);
+
         return {};
     }
 
-    std::unique_ptr<QZipWriter> m_zipWriter;
+    static constexpr int s_chunkSize = 65536;
+    static constexpr size_t s_elfHeaderSize = 52; // the smaller header of ELFCLASS32
+    static constexpr int s_elfMachineOffset = 18;
+    static constexpr quint64 s_dynamicNull = 0;
+    static constexpr quint64 s_dynamicNeeded = 1;
+    static constexpr quint64 s_dynamicRpath = 15;
+    static constexpr quint64 s_dynamicRunpath = 29;
+
+    std::unique_ptr<ZipWriter> m_zipWriter;
+    std::vector<DumpJob> m_jobs;
+    QThreadPool m_workers;
     QStringList m_libraryPath;
-    QString m_dumpSyms;
-    QString m_readElf;
-    QDir m_workDir;
+    QStringList m_systemLibraryPath;
+    QHash<QString, QSet<QString>> m_directoryEntries;
+    QHash<QString, ElfInfo> m_elfInfos;
+    QDir m_cacheDir;
+    qint64 m_cacheLimit = 0;
+    int m_cacheHits = 0;
+    int m_cacheMisses = 0;
+    int m_compressionLevel = 6;
+    int m_maximumJobs = 1;
+    int m_startedJobs = 0;
+    int m_runningJobs = 0;
+    int m_archivedJobs = 0;
+    bool m_failed = false;
 };
 
 } // namespace KDHockeyApp
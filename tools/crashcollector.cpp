@@ -0,0 +1,250 @@
+#include "KDHockeyAppCrashSignature_p.h"
+
+#include <KDHockeyAppManager.h>
+
+#include <client/linux/crash_generation/client_info.h>
+#include <client/linux/crash_generation/crash_generation_server.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QProcess>
+#include <QSet>
+#include <QTimer>
+#include <QUrl>
+
+#include <unistd.h>
+
+namespace KDHockeyApp {
+
+using google_breakpad::ClientInfo;
+using google_breakpad::CrashGenerationServer;
+
+class UploadNetworkAccessManager : public QNetworkAccessManager
+{
+public:
+    explicit UploadNetworkAccessManager(const QUrl &uploadUrl, QObject *parent)
+        : QNetworkAccessManager{parent}
+        , m_uploadUrl{uploadUrl}
+    {}
+
+protected:
+    QNetworkReply *createRequest(Operation operation, const QNetworkRequest &request, QIODevice *data) override
+    {
+        // crash reports are the only thing we post, send them to the stand-in endpoint if requested
+        if (operation != PostOperation || m_uploadUrl.isEmpty())
+            return QNetworkAccessManager::createRequest(operation, request, data);
+
+        auto redirected = request;
+        redirected.setUrl(m_uploadUrl);
+        return QNetworkAccessManager::createRequest(operation, redirected, data);
+    }
+
+private:
+    const QUrl m_uploadUrl;
+};
+
+class CrashCollector : public QCoreApplication
+{
+public:
+    using QCoreApplication::QCoreApplication;
+
+    int run()
+    {
+        QCommandLineParser args;
+        args.addOption({"app-id", "ID", "The HockeyApp application id to report crashes for"});
+        args.addOption({"spool", "PATH", "The directory where to collect crash reports"});
+        args.addOption({"upload-url", "URL", "Post crash reports to this URL instead of HockeyApp, e.g. a local test server"});
+        args.addOption({"batch-interval", "SECONDS", "Time between uploading batches of crash reports", "60"});
+        args.addOption({"batch-size", "COUNT", "Maximum number of crash reports per batch", "16"});
+        args.addPositionalArgument("COMMAND", "The worker command to run, its child processes share this collector");
+        args.parse(arguments());
+
+        const auto command = args.positionalArguments();
+        const auto appId = args.value("app-id");
+        m_spool.setPath(args.value("spool"));
+        m_batchSize = args.value("batch-size").toInt();
+
+        if (command.isEmpty() || appId.isEmpty() || m_spool.path().isEmpty() || m_batchSize < 1)
+            return EXIT_FAILURE;
+
+        if (!m_spool.mkpath(".")) {
+            qWarning("Could not create spool directory");
+            return EXIT_FAILURE;
+        }
+
+        int serverFd, clientFd;
+
+        if (!CrashGenerationServer::CreateReportChannel(&serverFd, &clientFd)) {
+            qWarning("Could not create the crash server socket");
+            return EXIT_FAILURE;
+        }
+
+        const auto spoolPath = QFile::encodeName(m_spool.absolutePath()).toStdString();
+        CrashGenerationServer server{serverFd, &CrashCollector::onMiniDumpWritten, this, nullptr, nullptr, true, &spoolPath};
+
+        if (!server.Start()) {
+            qWarning("Could not start the crash server");
+            return EXIT_FAILURE;
+        }
+
+        HockeyAppManager manager{appId};
+        manager.setNetworkAccessManager(new UploadNetworkAccessManager{QUrl::fromUserInput(args.value("upload-url")}, &manager});
+        m_manager = &manager;
+
+        // the workers find the crash server via the same variables HockeyAppManager uses
+        // for sharing its own crash server with child processes
+        auto environment = QProcessEnvironment::systemEnvironment();
+        environment.insert("KDHOCKEYAPP_CRASH_SERVER_FD", QString::number(clientFd));
+        environment.insert("KDHOCKEYAPP_CRASH_SERVER_PID", QString::number(applicationPid()));
+        environment.insert("KDHOCKEYAPP_CRASH_SERVER_DIR", m_spool.absolutePath());
+
+        QProcess workers;
+        workers.setProcessEnvironment(environment);
+        workers.setProcessChannelMode(QProcess::ForwardedChannels);
+
+        QTimer batchTimer;
+        batchTimer.setInterval(args.value("batch-interval").toInt() * 1000);
+        QObject::connect(&batchTimer, &QTimer::timeout, this, [this] { uploadBatch(); });
+
+        QObject::connect(&workers, QOverload<int, QProcess::ExitStatus>::of(&QProcess::finished), this, [this, &batchTimer] {
+            batchTimer.stop();
+            m_finished = true;
+            uploadBatch();
+        });
+
+        workers.start(command.first(), command.mid(1));
+
+        if (!workers.waitForStarted()) {
+            qWarning("Could not start %ls: %ls", qUtf16Printable(command.first()), qUtf16Printable(workers.errorString()));
+            server.Stop();
+            return EXIT_FAILURE;
+        }
+
+        batchTimer.start();
+        uploadBatch(); // reports left over from a previous run
+        exec();
+
+        server.Stop();
+        close(serverFd);
+        close(clientFd);
+
+        return workers.exitCode();
+    }
+
+private:
+    static void onMiniDumpWritten(void *context, const ClientInfo *client, const std::string *fileName)
+    {
+        // NOTICE: This runs on the crash server's thread.
+        // Clients register the file name they expect for their minidump. Their other crash files
+        // are named alike, and got written before the minidump was requested. Move all of them
+        // into the spool. The minidump goes last, as it marks the crash report complete.
+        const auto that = static_cast<const CrashCollector *>(context);
+        const auto registration = that->m_spool.filePath(QString::number(client->pid()) + ".client");
+        const auto miniDumpFileName = QFile::decodeName(fileName->c_str());
+        const QFileInfo target{QFile::symLinkTarget(registration)};
+
+        if (target.fileName().isEmpty()) {
+            qWarning("Unregistered client %d, keeping %ls", client->pid(), qUtf16Printable(miniDumpFileName));
+            return;
+        }
+
+        const auto baseName = target.completeBaseName();
+
+        for (const auto &crashFile: target.dir().entryInfoList({baseName + ".*"}, QDir::Files)) {
+            if (crashFile.suffix() != "dmp")
+                QFile::rename(crashFile.filePath(), that->m_spool.filePath(crashFile.fileName()));
+        }
+
+        if (!QFile::rename(miniDumpFileName, that->m_spool.filePath(baseName + ".dmp")))
+            qWarning("Could not move minidump %ls into the spool", qUtf16Printable(miniDumpFileName));
+
+        QFile::remove(registration);
+    }
+
+    void uploadBatch()
+    {
+        QHash<QByteArray, int> duplicates;
+        auto batchSize = 0;
+
+        for (const auto &dump: m_spool.entryInfoList({"*.dmp"}, QDir::Files, QDir::Time)) {
+            if (batchSize >= m_batchSize)
+                break;
+
+            const auto dumpFileName = dump.filePath();
+
+            if (m_uploading.contains(dumpFileName) || !isComplete(dump))
+                continue;
+
+            // Workers crashing on the same bug within one batch produce almost identical
+            // reports. Only the newest one gets uploaded, the others are dropped.
+            const auto signature = CrashSignature::fromMiniDump(dumpFileName);
+
+            if (!signature.isEmpty() && duplicates.contains(signature)) {
+                ++duplicates[signature];
+                removeCrashFiles(dump);
+                continue;
+            }
+
+            const auto reply = m_manager->uploadCrashDump(dumpFileName);
+
+            if (!reply)
+                continue; // not complete yet, or broken
+
+            if (!signature.isEmpty())
+                duplicates.insert(signature, 0);
+
+            m_uploading.insert(dumpFileName);
+            ++batchSize;
+
+            QObject::connect(reply, &QNetworkReply::finished, this, [this, dumpFileName] {
+                m_uploading.remove(dumpFileName);
+                quitWhenDone();
+            });
+        }
+
+        for (auto it = duplicates.cbegin(); it != duplicates.cend(); ++it) {
+            if (it.value() > 0)
+                qInfo("Dropped %d duplicates of crash %s", it.value(), it.key().constData());
+        }
+
+        quitWhenDone();
+    }
+
+    void quitWhenDone()
+    {
+        if (m_finished && m_uploading.isEmpty())
+            quit();
+    }
+
+    static bool isComplete(const QFileInfo &dump)
+    {
+        // minidumps without meta data are still being written, or moved into the spool
+        const auto commonFileName = dump.dir().filePath(dump.completeBaseName());
+        return QFile::exists(commonFileName + ".dsc") || QFile::exists(commonFileName + ".kdh");
+    }
+
+    static void removeCrashFiles(const QFileInfo &dump)
+    {
+        for (const auto &crashFile: dump.dir().entryInfoList({dump.completeBaseName() + ".*"}, QDir::Files))
+            QFile::remove(crashFile.filePath());
+    }
+
+    QDir m_spool;
+    HockeyAppManager *m_manager = nullptr;
+    QSet<QString> m_uploading;
+    int m_batchSize = 0;
+    bool m_finished = false;
+};
+
+} // namespace KDHockeyApp
+
+int main(int argc, char *argv[])
+{
+    return KDHockeyApp::CrashCollector{argc, argv}.run();
+}
@@ -0,0 +1,85 @@
+#include <client/linux/crash_generation/client_info.h>
+#include <client/linux/crash_generation/crash_generation_server.h>
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+
+#include <cerrno>
+
+#include <poll.h>
+
+namespace KDHockeyApp {
+
+using google_breakpad::ClientInfo;
+using google_breakpad::CrashGenerationServer;
+
+class CrashServer : public QCoreApplication
+{
+public:
+    using QCoreApplication::QCoreApplication;
+
+    int run()
+    {
+        QCommandLineParser args;
+        args.addOption({"socket", "FD", "The server end of the crash server socket"});
+        args.addOption({"dump-path", "PATH", "The directory where to write minidumps"});
+        args.parse(arguments());
+
+        bool valid = false;
+        const auto fd = args.value("socket").toInt(&valid);
+        m_dumpDir.setPath(args.value("dump-path"));
+
+        if (!valid || m_dumpDir.path().isEmpty() || !m_dumpDir.exists()) {
+            qWarning("Valid server socket and dump path required");
+            return EXIT_FAILURE;
+        }
+
+        const auto dumpPath = QFile::encodeName(m_dumpDir.absolutePath()).toStdString();
+        CrashGenerationServer server{fd, &CrashServer::onMiniDumpWritten, this, nullptr, nullptr, true, &dumpPath};
+
+        if (!server.Start()) {
+            qWarning("Could not start the crash server");
+            return EXIT_FAILURE;
+        }
+
+        // The server thread handles the dump requests. We only wait until the last
+        // client closed its end of the socket, which means all clients are gone.
+        pollfd hangup = {fd, 0, 0};
+        while (poll(&hangup, 1, -1) == -1 && errno == EINTR) {}
+
+        server.Stop();
+        return EXIT_SUCCESS;
+    }
+
+private:
+    static void onMiniDumpWritten(void *context, const ClientInfo *client, const std::string *fileName)
+    {
+        // Clients register the file name they expect for their minidump, because their crash
+        // files are named after it. Move the minidump there, and release the registration.
+        const auto that = static_cast<const CrashServer *>(context);
+        const auto registration = that->m_dumpDir.filePath(QString::number(client->pid()) + ".client");
+        const auto miniDumpFileName = QFile::decodeName(fileName->c_str());
+        const auto targetFileName = QFile::symLinkTarget(registration);
+
+        if (targetFileName.isEmpty()) {
+            qWarning("Unregistered client %d, keeping %ls", client->pid(), qUtf16Printable(miniDumpFileName));
+            return;
+        }
+
+        if (!QFile::rename(miniDumpFileName, targetFileName))
+            qWarning("Could not move minidump to %ls", qUtf16Printable(targetFileName));
+
+        QFile::remove(registration);
+    }
+
+    QDir m_dumpDir;
+};
+
+} // namespace KDHockeyApp
+
+int main(int argc, char *argv[])
+{
+    return KDHockeyApp::CrashServer{argc, argv}.run();
+}
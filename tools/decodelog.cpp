@@ -0,0 +1,318 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QFile>
+#include <QHash>
+#include <QMap>
+#include <QTextStream>
+#include <QVector>
+
+namespace KDHockeyApp {
+
+class DecodeLog : public QCoreApplication
+{
+public:
+    using QCoreApplication::QCoreApplication;
+
+    int run()
+    {
+        QCommandLineParser args;
+        args.addPositionalArgument("LOGFILE", "The crash log, or breadcrumbs to convert into text");
+        args.parse(arguments());
+
+        const auto pargs = args.positionalArguments();
+
+        if (pargs.size() != 1)
+            return EXIT_FAILURE;
+
+        QFile file{pargs.at(0)};
+
+        if (!file.open(QFile::ReadOnly)) {
+            qWarning("Could not open %ls: %ls", qUtf16Printable(file.fileName()), qUtf16Printable(file.errorString()));
+            return EXIT_FAILURE;
+        }
+
+        const auto data = file.readAll();
+        QFile output;
+
+        if (!output.open(stdout, QFile::WriteOnly))
+            return EXIT_FAILURE;
+
+        if (data.startsWith(s_breadcrumbsMagic)) {
+            QTextStream stream{&output};
+
+            for (const auto &breadcrumb: readBreadcrumbs(data))
+                stream << breadcrumb << '\n';
+
+            return EXIT_SUCCESS;
+        }
+
+        // text logs are passed through unmodified
+        if (!data.startsWith(s_binaryLogMagic)) {
+            output.write(data);
+            return EXIT_SUCCESS;
+        }
+
+        if (data.size() < s_binaryLogHeaderSize || data[8] != 1) {
+            qWarning("Unsupported log format version");
+            return EXIT_FAILURE;
+        }
+
+        QVector<Section> sections;
+
+        for (auto offset = s_binaryLogHeaderSize; offset < data.size(); ) {
+            Section section;
+            section.tier = static_cast<uchar>(data[offset++]);
+
+            if (offset + 4 > data.size()) {
+                qWarning("Truncated section header at offset %d", offset);
+                break;
+            }
+
+            const auto size = static_cast<int>(readLittleEndian(data, offset, 4));
+            offset += 4;
+
+            section.content = data.mid(offset, size);
+            offset += size;
+
+            if (section.tier == s_stringsTier)
+                readDefinitions(section.content);
+            else
+                sections.append(section);
+        }
+
+        QTextStream stream{&output};
+
+        for (const auto &section: sections) {
+            if (section.tier > 0 && section.tier < s_stringsTier)
+                stream << "\n---- " << s_tierTitles[section.tier - 1] << " ----\n";
+
+            for (const auto &record: readRecords(section.content))
+                stream << record << '\n';
+        }
+
+        return EXIT_SUCCESS;
+    }
+
+private:
+    struct Section
+    {
+        int tier = 0;
+        QByteArray content;
+    };
+
+    static quint64 readLittleEndian(const QByteArray &data, int offset, int size)
+    {
+        quint64 value = 0;
+
+        for (auto i = 0; i < size; ++i)
+            value |= static_cast<quint64>(static_cast<uchar>(data[offset + i])) << (8 * i);
+
+        return value;
+    }
+
+    static bool readVarint(const QByteArray &data, int *offset, quint64 *value)
+    {
+        *value = 0;
+
+        for (auto shift = 0; *offset < data.size() && shift < 64; shift += 7) {
+            const auto byte = static_cast<uchar>(data[(*offset)++]);
+            *value |= static_cast<quint64>(byte & 0x7f) << shift;
+
+            if (!(byte & 0x80))
+                return true;
+        }
+
+        return false;
+    }
+
+    void readDefinitions(const QByteArray &data)
+    {
+        for (auto offset = 0; offset < data.size(); ) {
+            quint64 id, length;
+
+            if (!readVarint(data, &offset, &id)
+                    || !readVarint(data, &offset, &length)
+                    || offset + static_cast<int>(length) > data.size())
+                break;
+
+            const auto value = data.mid(offset, static_cast<int>(length));
+            offset += static_cast<int>(length);
+
+            if (id == 0 && length == 8)
+                m_epoch = static_cast<qint64>(readLittleEndian(value, 0, 8));
+            else
+                m_strings.insert(id, value);
+        }
+    }
+
+    bool readStringReference(const QByteArray &data, int *offset, QByteArray *value) const
+    {
+        quint64 reference;
+
+        if (!readVarint(data, offset, &reference))
+            return false;
+
+        if (reference == 0) {
+            *value = {};
+        } else if (reference & 1) {
+            const auto length = static_cast<int>(reference >> 1);
+
+            if (*offset + length > data.size())
+                return false;
+
+            *value = data.mid(*offset, length);
+            *offset += length;
+        } else {
+            *value = m_strings.value(reference >> 1, "<unknown string #" + QByteArray::number(reference >> 1) + '>');
+        }
+
+        return true;
+    }
+
+    QString decodeRecord(const QByteArray &record) const
+    {
+        static const char typePrefixes[] = {'D', 'W', 'C', 'F', 'I'};
+
+        quint64 timestamp, line;
+        QByteArray category, function;
+        auto offset = 0;
+
+        if (!readVarint(record, &offset, &timestamp) || offset >= record.size())
+            return {};
+
+        const auto type = static_cast<uchar>(record[offset++]);
+
+        if (type >= sizeof typePrefixes
+                || !readStringReference(record, &offset, &category)
+                || !readStringReference(record, &offset, &function)
+                || !readVarint(record, &offset, &line))
+            return {};
+
+        QString text;
+        QTextStream stream{&text};
+
+        const auto milliseconds = static_cast<qint64>(timestamp / 1000);
+
+        if (m_epoch > 0)
+            stream << QDateTime::fromMSecsSinceEpoch(m_epoch + milliseconds).toString(Qt::ISODateWithMs);
+        else
+            stream << milliseconds << "ms";
+
+        stream << " [" << typePrefixes[type] << "] ";
+
+        if (!category.isEmpty())
+            stream << category << ": ";
+
+        if (!function.isEmpty()) {
+            stream << function;
+
+            if (line > 0)
+                stream << ", line " << line;
+
+            stream << ": ";
+        }
+
+        stream << QString::fromUtf8(record.mid(offset));
+        stream.flush();
+
+        return text;
+    }
+
+    QStringList readRecords(const QByteArray &data) const
+    {
+        QStringList records;
+
+        // each record ends with its size, therefore the ring gets decoded from its newest
+        // record backwards. The oldest record usually is incomplete after the ring wrapped.
+        for (auto end = data.size(); end >= s_recordTrailerSize; ) {
+            const auto size = static_cast<int>(readLittleEndian(data, end - s_recordTrailerSize, s_recordTrailerSize));
+            const auto begin = end - s_recordTrailerSize - size;
+
+            if (begin < 0)
+                break;
+
+            const auto text = decodeRecord(data.mid(begin, size));
+
+            if (text.isNull()) {
+                qWarning("Stopping at corrupt record at offset %d", begin);
+                break;
+            }
+
+            records.prepend(text);
+            end = begin;
+        }
+
+        return records;
+    }
+
+    static QStringList readBreadcrumbs(const QByteArray &data)
+    {
+        if (data.size() < s_breadcrumbsHeaderSize || data[8] != 1) {
+            qWarning("Unsupported breadcrumbs format version");
+            return {};
+        }
+
+        const auto capacity = static_cast<int>(readLittleEndian(data, 12, 4));
+        const auto epoch = static_cast<qint64>(readLittleEndian(data, 16, 8));
+        QMap<quint64, QString> breadcrumbs;
+
+        for (auto i = 0; i < capacity; ++i) {
+            const auto offset = s_breadcrumbsHeaderSize + i * s_breadcrumbSize;
+
+            if (offset + s_breadcrumbSize > data.size())
+                break;
+
+            // records without sequence number are unused, or were written while crashing
+            const auto sequence = readLittleEndian(data, offset, 8);
+
+            if (sequence == 0)
+                continue;
+
+            const auto timestamp = static_cast<qint64>(readLittleEndian(data, offset + 8, 8));
+            const auto type = static_cast<int>(readLittleEndian(data, offset + 16, 2));
+            const auto size = qMin(static_cast<int>(readLittleEndian(data, offset + 18, 2)), s_breadcrumbTextSize);
+
+            QString text;
+            QTextStream{&text}
+                    << QDateTime::fromMSecsSinceEpoch(epoch + timestamp / 1000).toString(Qt::ISODateWithMs)
+                    << " [" << (type < s_breadcrumbTypeCount ? s_breadcrumbTypes[type] : "unknown") << "] "
+                    << QString::fromUtf8(data.mid(offset + 24, size));
+
+            breadcrumbs.insert(sequence, text);
+        }
+
+        return breadcrumbs.values();
+    }
+
+    static constexpr char s_binaryLogMagic[] = "KDHALOGB";
+    static constexpr char s_breadcrumbsMagic[] = "KDHABCRB";
+    static constexpr int s_breadcrumbsHeaderSize = 24;
+    static constexpr int s_breadcrumbSize = 128;
+    static constexpr int s_breadcrumbTextSize = 104;
+    static constexpr int s_breadcrumbTypeCount = 5;
+    static constexpr const char *s_breadcrumbTypes[s_breadcrumbTypeCount] = {
+        "navigation", "network", "user action", "lifecycle", "custom"
+    };
+    static constexpr int s_binaryLogHeaderSize = 12;
+    static constexpr int s_recordTrailerSize = 2;
+    static constexpr int s_stringsTier = 6;
+    static constexpr const char *s_tierTitles[] = {
+        "debug messages", "warnings", "critical messages", "fatal messages", "info messages"
+    };
+
+    QHash<quint64, QByteArray> m_strings;
+    qint64 m_epoch = 0;
+};
+
+constexpr char DecodeLog::s_binaryLogMagic[];
+constexpr char DecodeLog::s_breadcrumbsMagic[];
+constexpr const char *DecodeLog::s_breadcrumbTypes[];
+constexpr const char *DecodeLog::s_tierTitles[];
+
+} // namespace KDHockeyApp
+
+int main(int argc, char *argv[])
+{
+    return KDHockeyApp::DecodeLog{argc, argv}.run();
+}
@@ -0,0 +1,170 @@
+#include <KDHockeyAppManager.h>
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QHash>
+#include <QProcess>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QUrl>
+
+#include <cstdlib>
+
+namespace KDHockeyApp {
+
+namespace {
+
+constexpr int s_workerExitCode = 3;
+constexpr int s_timeout = 60000;
+
+} // namespace
+
+// Stands in for HockeyApp's upload endpoint, and accepts every crash report.
+class UploadServer : public QTcpServer
+{
+public:
+    explicit UploadServer(QObject *parent = nullptr)
+        : QTcpServer{parent}
+    {
+        QObject::connect(this, &QTcpServer::newConnection, this, [this] {
+            while (const auto socket = nextPendingConnection()) {
+                QObject::connect(socket, &QTcpSocket::readyRead, this, [this, socket] { readRequest(socket); });
+                QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            }
+        });
+    }
+
+    QUrl url() const { return QUrl{"http://127.0.0.1:" + QString::number(serverPort()) + "/crashes"}; }
+    int requestCount() const { return m_requestCount; }
+
+private:
+    void readRequest(QTcpSocket *socket)
+    {
+        auto &buffer = m_buffers[socket];
+        buffer += socket->readAll();
+
+        const auto headerEnd = buffer.indexOf("\r\n\r\n");
+
+        if (headerEnd < 0)
+            return;
+
+        auto contentLength = 0;
+
+        for (const auto &line: buffer.left(headerEnd).split('\n')) {
+            if (line.toLower().startsWith("content-length:"))
+                contentLength = line.mid(15).trimmed().toInt();
+        }
+
+        if (buffer.size() < headerEnd + 4 + contentLength)
+            return;
+
+        m_buffers.remove(socket);
+        ++m_requestCount;
+
+        socket->write("HTTP/1.1 201 Created\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        socket->disconnectFromHost();
+    }
+
+    QHash<QTcpSocket *, QByteArray> m_buffers;
+    int m_requestCount = 0;
+};
+
+// Runs crashcollector with this program as its worker command. The worker spawns
+// child processes which crash, some of them on the same bug. Verifies that each
+// distinct crash gets uploaded once to the stand-in endpoint, that duplicates get
+// dropped, that the spool gets emptied, and that the worker's exit code is passed on.
+// The collector is expected next to this program.
+class TestCrashCollector : public QObject
+{
+    Q_OBJECT
+
+public:
+    static int spawnCrashes()
+    {
+        // three crashes on the same bug, and another one
+        for (const auto kind: {"segv", "segv", "segv", "abort"})
+            QProcess::execute(QCoreApplication::applicationFilePath(), {"--crash", kind});
+
+        return s_workerExitCode;
+    }
+
+    static int crash(const QString &kind)
+    {
+        HockeyAppManager manager{"0123456789abcdef"};
+
+        if (kind == "abort")
+            abort();
+
+        writeThrough(nullptr);
+        return EXIT_SUCCESS;
+    }
+
+private slots:
+    void collectCrashes()
+    {
+        QTemporaryDir dir;
+        UploadServer server;
+
+        QVERIFY(dir.isValid());
+        QVERIFY(server.listen(QHostAddress::LocalHost));
+
+        const QDir spool{dir.filePath("spool")};
+
+        // the crashing processes keep their crash files in this cache, until the collector takes them
+        auto environment = QProcessEnvironment::systemEnvironment();
+        environment.insert("XDG_CACHE_HOME", dir.filePath("cache"));
+
+        QProcess process;
+        process.setProcessEnvironment(environment);
+        process.setProcessChannelMode(QProcess::ForwardedChannels);
+        process.start(QCoreApplication::applicationDirPath() + "/crashcollector", {
+                          "--app-id", "0123456789abcdef",
+                          "--spool", spool.path(),
+                          "--upload-url", server.url().toString(),
+                          "--batch-interval", "3600",
+                          QCoreApplication::applicationFilePath(), "--worker"
+                      });
+
+        QVERIFY2(process.waitForStarted(), qPrintable(process.errorString()));
+
+        // the uploads are served by this event loop, don't block it
+        QTRY_VERIFY_WITH_TIMEOUT(process.state() == QProcess::NotRunning, s_timeout);
+
+        // the worker's exit code is passed on
+        QCOMPARE(process.exitStatus(), QProcess::NormalExit);
+        QCOMPARE(process.exitCode(), s_workerExitCode);
+
+        // each distinct crash gets uploaded once
+        QCOMPARE(server.requestCount(), 2);
+
+        // uploaded reports and dropped duplicates are removed from the spool
+        QCOMPARE(spool.entryList({"*.dmp", "*.client"}, QDir::Files | QDir::System), QStringList{});
+    }
+
+private:
+    Q_DECL_NOINLINE static void writeThrough(volatile int *pointer)
+    {
+        *pointer = 42;
+    }
+};
+
+} // namespace KDHockeyApp
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app{argc, argv};
+    const auto arguments = app.arguments();
+
+    // the modes in which the crash collector runs this program
+    if (arguments.value(1) == "--worker")
+        return KDHockeyApp::TestCrashCollector::spawnCrashes();
+    if (arguments.value(1) == "--crash")
+        return KDHockeyApp::TestCrashCollector::crash(arguments.value(2));
+
+    KDHockeyApp::TestCrashCollector test;
+    return QTest::qExec(&test, argc, argv);
+}
+
+#include "testcrashcollector.moc"
@@ -0,0 +1,262 @@
+#include "KDHockeyAppCrashSignature_p.h"
+
+#include <google_breakpad/common/minidump_format.h>
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QVector>
+
+#include <cstring>
+
+namespace KDHockeyApp {
+
+namespace {
+
+constexpr quint32 s_streamCount = 4;
+constexpr quint32 s_threadId = 4242;
+constexpr quint32 s_sigsegv = 11;
+constexpr quint32 s_sigabrt = 6;
+constexpr int s_staleWordCount = 64;
+constexpr quint64 s_noAddress = 42; // a stack word which doesn't point into any module
+
+} // namespace
+
+// Verifies that crash signatures identify the same crash across processes: They must
+// not depend on where modules got loaded, nor on stale data below the stack pointer,
+// but they must tell different crashes apart. Also verifies the sampling of repeated
+// crashes by CrashSignatureIndex. The minidumps are synthetic, and only contain the
+// streams CrashSignature reads.
+class TestCrashSignature : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        QVERIFY(m_dir.isValid());
+
+        m_crash.staleFrames = {0x5000, 0x6000};
+        m_crash.frames = {0x2000, 0x3000, 0x4000};
+    }
+
+    void computeSignature()
+    {
+        QVERIFY(!signatureOf(m_crash).isEmpty());
+    }
+
+    void ignoreModuleAddresses()
+    {
+        auto relocated = m_crash;
+        relocated.moduleBase += 0x123450000;
+        QCOMPARE(signatureOf(relocated), signatureOf(m_crash));
+    }
+
+    void ignoreStaleFrames()
+    {
+        auto staleFramesChanged = m_crash;
+        staleFramesChanged.staleFrames = {0x7000, 0x8000, 0x9000};
+        QCOMPARE(signatureOf(staleFramesChanged), signatureOf(m_crash));
+    }
+
+    void distinguishCallers()
+    {
+        auto otherCaller = m_crash;
+        otherCaller.frames[1] = 0x3100;
+        QVERIFY(signatureOf(otherCaller) != signatureOf(m_crash));
+    }
+
+    void distinguishExceptions()
+    {
+        auto otherException = m_crash;
+        otherException.exceptionCode = s_sigabrt;
+        QVERIFY(signatureOf(otherException) != signatureOf(m_crash));
+    }
+
+    void considerTopFramesOnly()
+    {
+        auto deepFrame = m_crash;
+        deepFrame.frames.append(0x4100);
+        QCOMPARE(signatureOf(deepFrame, 4), signatureOf(m_crash, 4));
+    }
+
+    void rejectTruncatedMiniDumps()
+    {
+        const auto truncated = writeMiniDump(miniDump(m_crash).left(200));
+        QCOMPARE(CrashSignature::fromMiniDump(truncated), QByteArray{});
+    }
+
+    void sampleRepeatedCrashes()
+    {
+        CrashSignatureIndex index{m_dir.filePath("signatures.ini")};
+        const auto signature = signatureOf(m_crash);
+
+        // every crash counts once while the full report limit is zero
+        QCOMPARE(index.record(signature), 1);
+        QCOMPARE(index.record(signature), 1);
+
+        // the first two reports, and then those whose running count is a power of two
+        index.setFullReportLimit(2);
+
+        auto otherCaller = m_crash;
+        otherCaller.frames[1] = 0x3100;
+
+        const auto otherSignature = signatureOf(otherCaller);
+        const QVector<int> expected = {1, 1, 0, 2, 0, 0, 0, 4, 0};
+        QVector<int> occurrences;
+
+        for (auto i = 0; i < expected.count(); ++i)
+            occurrences.append(index.record(otherSignature));
+
+        QCOMPARE(occurrences, expected);
+    }
+
+private:
+    // The crashing thread runs code of two modules. Frames are given as offsets into
+    // the first module, stale frames are stored below the stack pointer.
+    struct Crash
+    {
+        quint32 exceptionCode = s_sigsegv;
+        quint64 moduleBase = 0x7f0000000000;
+        quint64 crashOffset = 0x1234;
+        QVector<quint64> staleFrames;
+        QVector<quint64> frames;
+    };
+
+    template<typename T>
+    static quint32 append(QByteArray *data, const T &value)
+    {
+        const auto rva = static_cast<quint32>(data->size());
+        data->append(reinterpret_cast<const char *>(&value), sizeof value);
+        return rva;
+    }
+
+    template<typename T>
+    static void replace(QByteArray *data, quint32 rva, const T &value)
+    {
+        memcpy(data->data() + rva, &value, sizeof value);
+    }
+
+    static QByteArray miniDump(const Crash &crash)
+    {
+        QByteArray data{sizeof(MDRawHeader) + s_streamCount * sizeof(MDRawDirectory), '\0'};
+        MDRawDirectory directory[s_streamCount] = {};
+
+        MDRawSystemInfo systemInfo = {};
+        systemInfo.processor_architecture = MD_CPU_ARCHITECTURE_AMD64;
+        systemInfo.platform_id = MD_OS_LINUX;
+
+        directory[0].stream_type = MD_SYSTEM_INFO_STREAM;
+        directory[0].location = {sizeof systemInfo, append(&data, systemInfo)};
+
+        // the stack memory starts at a page boundary, like Breakpad captures it on Linux
+        const quint64 stackStart = 0x7ffc12340000;
+        QVector<quint64> stack;
+
+        for (const auto offset: crash.staleFrames)
+            stack << crash.moduleBase + offset << s_noAddress;
+
+        stack.resize(s_staleWordCount);
+        const auto stackPointer = stackStart + static_cast<quint64>(stack.count()) * sizeof(quint64);
+
+        for (const auto offset: crash.frames)
+            stack << s_noAddress << crash.moduleBase + offset;
+
+        MDRawContextAMD64 context = {};
+        context.context_flags = MD_CONTEXT_AMD64_FULL;
+        context.rip = crash.moduleBase + crash.crashOffset;
+        context.rsp = stackPointer;
+
+        const auto contextRva = append(&data, context);
+        const auto stackRva = static_cast<quint32>(data.size());
+        data.append(reinterpret_cast<const char *>(stack.constData()), stack.count() * static_cast<int>(sizeof(quint64)));
+
+        MDRawThread thread = {};
+        thread.thread_id = s_threadId;
+        thread.stack.start_of_memory_range = stackStart;
+        thread.stack.memory = {static_cast<quint32>(stack.count() * sizeof(quint64)), stackRva};
+        thread.thread_context = {sizeof context, contextRva};
+
+        const quint32 threadCount = 1;
+        directory[1].stream_type = MD_THREAD_LIST_STREAM;
+        directory[1].location = {sizeof threadCount + sizeof thread, append(&data, threadCount)};
+        append(&data, thread);
+
+        MDRawExceptionStream exception = {};
+        exception.thread_id = s_threadId;
+        exception.exception_record.exception_code = crash.exceptionCode;
+        exception.exception_record.exception_address = context.rip;
+        exception.thread_context = thread.thread_context;
+
+        directory[2].stream_type = MD_EXCEPTION_STREAM;
+        directory[2].location = {sizeof exception, append(&data, exception)};
+
+        const struct {
+            quint64 base;
+            quint32 size;
+            QString name;
+        } modules[] = {
+            {crash.moduleBase, 0x100000, QStringLiteral("/opt/worker/lib/libworker.so")},
+            {crash.moduleBase + 0x1000000, 0x200000, QStringLiteral("/lib/x86_64-linux-gnu/libc.so.6")},
+        };
+
+        const quint32 moduleCount = sizeof modules / sizeof modules[0];
+        const auto moduleListRva = append(&data, moduleCount);
+
+        // the modules are stored with their packed size, which is smaller than sizeof(MDRawModule)
+        data.append(QByteArray{static_cast<int>(moduleCount * MD_MODULE_SIZE), '\0'});
+
+        directory[3].stream_type = MD_MODULE_LIST_STREAM;
+        directory[3].location = {sizeof moduleCount + moduleCount * MD_MODULE_SIZE, moduleListRva};
+
+        for (quint32 i = 0; i < moduleCount; ++i) {
+            const auto nameRva = append(&data, static_cast<quint32>(modules[i].name.size() * 2));
+            data.append(reinterpret_cast<const char *>(modules[i].name.utf16()), modules[i].name.size() * 2);
+
+            MDRawModule module = {};
+            module.base_of_image = modules[i].base;
+            module.size_of_image = modules[i].size;
+            module.module_name_rva = nameRva;
+
+            memcpy(data.data() + moduleListRva + sizeof moduleCount + i * MD_MODULE_SIZE, &module, MD_MODULE_SIZE);
+        }
+
+        MDRawHeader header = {};
+        header.signature = MD_HEADER_SIGNATURE;
+        header.version = MD_HEADER_VERSION;
+        header.stream_count = s_streamCount;
+        header.stream_directory_rva = sizeof header;
+
+        replace(&data, 0, header);
+
+        for (quint32 i = 0; i < s_streamCount; ++i)
+            replace(&data, static_cast<quint32>(sizeof header + i * sizeof(MDRawDirectory)), directory[i]);
+
+        return data;
+    }
+
+    QString writeMiniDump(const QByteArray &data)
+    {
+        QFile file{m_dir.filePath(QString::number(++m_fileCount) + ".dmp")};
+
+        if (!file.open(QFile::WriteOnly) || file.write(data) != data.size())
+            qFatal("Could not write %s", qPrintable(file.fileName()));
+
+        return file.fileName();
+    }
+
+    QByteArray signatureOf(const Crash &crash, int frameCount = 8)
+    {
+        return CrashSignature::fromMiniDump(writeMiniDump(miniDump(crash)), frameCount);
+    }
+
+    QTemporaryDir m_dir;
+    Crash m_crash;
+    int m_fileCount = 0;
+};
+
+} // namespace KDHockeyApp
+
+QTEST_GUILESS_MAIN(KDHockeyApp::TestCrashSignature)
+
+#include "testcrashsignature.moc"
@@ -0,0 +1,303 @@
+#include "KDHockeyAppCrashSignature_p.h"
+#include "KDHockeyAppCrashSpool_p.h"
+#include "KDHockeyAppUploadQueue_p.h"
+
+#include <KDHockeyAppManager.h>
+
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QHttpMultiPart>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <QtConcurrentRun>
+
+#include <memory>
+
+namespace KDHockeyApp {
+
+namespace {
+
+constexpr int s_responseDelay = 100;
+constexpr int s_successfulCount = 6;
+constexpr int s_maximumActiveUploads = 2;
+constexpr int s_maximumAttempts = 8; // see UploadQueue
+constexpr int s_timeout = 10000;
+
+} // namespace
+
+// Stands in for HockeyApp's upload endpoint. Each crash report is posted to a path
+// named after its crash id, and the crash id's prefix tells how to respond: "ok"
+// reports succeed, "retry" and "exhausted" reports fail with a server error, and
+// "reject" reports fail with a client error. Responses are delayed, so that the
+// uploads overlap, and the maximum number of concurrent requests can be observed.
+class UploadServer : public QTcpServer
+{
+public:
+    explicit UploadServer(QObject *parent = nullptr)
+        : QTcpServer{parent}
+    {
+        QObject::connect(this, &QTcpServer::newConnection, this, [this] {
+            while (const auto socket = nextPendingConnection()) {
+                QObject::connect(socket, &QTcpSocket::readyRead, this, [this, socket] { readRequest(socket); });
+                QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            }
+        });
+    }
+
+    QUrl url() const { return QUrl{"http://127.0.0.1:" + QString::number(serverPort()) + "/"}; }
+    QStringList requests() const { return m_requests; }
+    int maximumActiveRequests() const { return m_maximumActiveRequests; }
+
+private:
+    void readRequest(QTcpSocket *socket)
+    {
+        auto &buffer = m_buffers[socket];
+        buffer += socket->readAll();
+
+        const auto headerEnd = buffer.indexOf("\r\n\r\n");
+
+        if (headerEnd < 0)
+            return;
+
+        const auto header = buffer.left(headerEnd).split('\n');
+        auto contentLength = 0;
+
+        for (const auto &line: header) {
+            if (line.toLower().startsWith("content-length:"))
+                contentLength = line.mid(15).trimmed().toInt();
+        }
+
+        if (buffer.size() < headerEnd + 4 + contentLength)
+            return;
+
+        const auto crashId = QString::fromLatin1(header.first().split(' ').value(1).mid(1));
+        m_buffers.remove(socket);
+        m_requests.append(crashId);
+        m_maximumActiveRequests = qMax(m_maximumActiveRequests, ++m_activeRequests);
+
+        QTimer::singleShot(s_responseDelay, socket, [this, socket, crashId] {
+            --m_activeRequests;
+
+            QByteArray status = "201 Created";
+
+            if (crashId.startsWith("retry") || crashId.startsWith("exhausted"))
+                status = "503 Service Unavailable";
+            else if (crashId.startsWith("reject"))
+                status = "400 Bad Request";
+
+            socket->write("HTTP/1.1 " + status + "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            socket->disconnectFromHost();
+        });
+    }
+
+    QHash<QTcpSocket *, QByteArray> m_buffers;
+    QStringList m_requests;
+    int m_activeRequests = 0;
+    int m_maximumActiveRequests = 0;
+};
+
+// Uploads a set of fake crash reports through UploadQueue to the stand-in server,
+// and verifies the limit of concurrent uploads, the order of uploads, the backoff
+// of failed uploads, the state kept in uploads.ini, the removal of reports
+// which cannot be uploaded, and forgetting about reports the spool evicted.
+class TestUploadQueue : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase()
+    {
+        QStandardPaths::setTestModeEnabled(true);
+
+        QVERIFY(m_crashDir.isValid());
+        QVERIFY(m_server.listen(QHostAddress::LocalHost));
+
+        for (auto i = 0; i < s_successfulCount; ++i)
+            QVERIFY(createCrashReport("ok" + QString::number(i), m_now.addSecs(-60 * i)));
+
+        QVERIFY(createCrashReport("retry", m_now.addSecs(-3600)));
+        QVERIFY(createCrashReport("reject", m_now.addSecs(-3601)));
+        QVERIFY(createCrashReport("exhausted", m_now.addSecs(-3602)));
+        QVERIFY(createCrashReport("later", m_now.addSecs(-3603)));
+
+        // the state of reports which failed in previous sessions
+        QSettings state{m_crashDir.filePath("uploads.ini"), QSettings::IniFormat};
+        state.setValue("exhausted/Attempts", s_maximumAttempts - 1);
+        state.setValue("exhausted/NotBefore", 0);
+        state.setValue("later/Attempts", 1);
+        state.setValue("later/NotBefore", m_now.addSecs(3600).toMSecsSinceEpoch());
+
+        m_manager.reset(new HockeyAppManager{"testuploadqueue"});
+
+        connect(m_manager.get(), &HockeyAppManager::crashDumpUploaded, this, [this] { ++m_finished; });
+        connect(m_manager.get(), &HockeyAppManager::crashDumpUploadFailed, this, [this] { ++m_finished; });
+    }
+
+    void uploadCrashReports()
+    {
+        {
+            UploadQueue queue{m_manager.get(), &m_signatures, &m_spool, &TestUploadQueue::prepareCrashReport,
+                              [this](const CrashReport &report) { return post(report); }};
+            queue.setMaximumActiveUploads(s_maximumActiveUploads);
+            queue.enqueueCrashDumps(m_crashDir.path());
+
+            // "later" is not due yet, all others get posted once
+            QTRY_COMPARE_WITH_TIMEOUT(m_finished, s_successfulCount + 3, s_timeout);
+            QThreadPool::globalInstance()->waitForDone();
+
+            QCOMPARE(m_server.maximumActiveRequests(), s_maximumActiveUploads);
+            QCOMPARE(m_server.requests().count(), s_successfulCount + 3);
+
+            // the newest reports get uploaded first
+            for (const auto &crashId: m_server.requests().mid(0, s_successfulCount))
+                QVERIFY2(crashId.startsWith("ok"), qPrintable(crashId));
+
+            // the failed and the deferred report stay queued
+            QCOMPARE(queue.pendingCount(), 2);
+            QCOMPARE(queue.activeCount(), 0);
+        }
+
+        QSettings state{m_crashDir.filePath("uploads.ini"), QSettings::IniFormat};
+        const auto notBefore = QDateTime::fromMSecsSinceEpoch(state.value("retry/NotBefore").toLongLong(), Qt::UTC);
+
+        // failed uploads are counted, and retried after a delay
+        QCOMPARE(state.value("retry/Attempts").toInt(), 1);
+        QVERIFY(notBefore >= m_now.addSecs(25));
+        QVERIFY(notBefore <= m_now.addSecs(60));
+
+        // rejected reports, and those which exhausted their attempts, are deleted with their state
+        QVERIFY(!state.childGroups().contains("reject"));
+        QVERIFY(!hasCrashFiles("reject"));
+        QVERIFY(!state.childGroups().contains("exhausted"));
+        QVERIFY(!hasCrashFiles("exhausted"));
+
+        QVERIFY(hasCrashFiles("retry"));
+        QVERIFY(hasCrashFiles("later"));
+    }
+
+    void restoreState()
+    {
+        const auto requestCount = m_server.requests().count();
+
+        UploadQueue queue{m_manager.get(), &m_signatures, &m_spool, &TestUploadQueue::prepareCrashReport,
+                          [this](const CrashReport &report) { return post(report); }};
+        queue.setMaximumActiveUploads(s_maximumActiveUploads);
+        queue.enqueueCrashDumps(m_crashDir.path());
+
+        // another session must pick up the stored state, instead of posting again right away
+        QTRY_VERIFY_WITH_TIMEOUT(queue.pendingCount() > 0, s_timeout);
+        QCOMPARE(queue.pendingCount(), 2);
+        QCOMPARE(m_server.requests().count(), requestCount);
+
+        // a quota which leaves no room for the queued reports
+        m_spool.setQuota(0, 1);
+        m_spool.scheduleUpdate();
+
+        // evicted reports are forgotten with their state
+        QTRY_COMPARE_WITH_TIMEOUT(queue.pendingCount(), 0, s_timeout);
+        QVERIFY(!hasCrashFiles("retry"));
+        QVERIFY(!hasCrashFiles("later"));
+
+        QSettings state{m_crashDir.filePath("uploads.ini"), QSettings::IniFormat};
+        QCOMPARE(state.childGroups(), QStringList{});
+    }
+
+private:
+    bool createCrashReport(const QString &crashId, const QDateTime &lastModified)
+    {
+        for (const auto suffix: {".dsc", ".log", ".dmp"}) {
+            QFile file{m_crashDir.filePath(crashId + suffix)};
+
+            if (!file.open(QFile::WriteOnly) || file.write("test data\n") < 0 || !file.flush())
+                return false;
+
+            file.setFileTime(lastModified, QFileDevice::FileModificationTime);
+        }
+
+        return true;
+    }
+
+    bool hasCrashFiles(const QString &crashId) const
+    {
+        return !QDir{m_crashDir.path()}.entryList({crashId + ".*"}, QDir::Files).isEmpty();
+    }
+
+    void removeCrashFiles(const QString &crashId)
+    {
+        const QDir dir{m_crashDir.path()};
+
+        for (const auto &fileName: dir.entryList({crashId + ".*"}, QDir::Files))
+            QFile::remove(dir.filePath(fileName));
+    }
+
+    static QFuture<CrashReport> prepareCrashReport(const QString &dumpFileName, int)
+    {
+        const auto targetThread = QThread::currentThread();
+
+        return QtConcurrent::run([dumpFileName, targetThread] {
+            CrashReport report;
+            report.crashId = QFileInfo{dumpFileName}.baseName();
+            report.crashFiles << dumpFileName;
+
+            QFile file{dumpFileName};
+
+            if (file.open(QFile::ReadOnly)) {
+                QHttpPart part;
+                part.setHeader(QNetworkRequest::ContentDispositionHeader, R"(form-data; name="attachment0")");
+                part.setBody(file.readAll());
+
+                report.formData = new QHttpMultiPart{QHttpMultiPart::FormDataType};
+                report.formData->append(part);
+                report.formData->moveToThread(targetThread);
+            }
+
+            return report;
+        });
+    }
+
+    QNetworkReply *post(const CrashReport &report)
+    {
+        if (!report.formData)
+            return nullptr;
+
+        const auto reply = m_network.post(QNetworkRequest{m_server.url().resolved(QUrl{report.crashId})}, report.formData);
+        report.formData->setParent(reply);
+
+        // like HockeyAppManager, delete the reports which got uploaded
+        connect(reply, &QNetworkReply::finished, this, [this, reply, crashId = report.crashId] {
+            if (reply->error() == QNetworkReply::NoError)
+                removeCrashFiles(crashId);
+
+            reply->deleteLater();
+        });
+
+        return reply;
+    }
+
+    const QDateTime m_now = QDateTime::currentDateTimeUtc();
+    QTemporaryDir m_crashDir;
+    UploadServer m_server;
+    CrashSignatureIndex m_signatures{m_crashDir.filePath("signatures.ini")};
+    CrashSpool m_spool{m_crashDir.path()};
+    QNetworkAccessManager m_network;
+    std::unique_ptr<HockeyAppManager> m_manager;
+    int m_finished = 0;
+};
+
+} // namespace KDHockeyApp
+
+QTEST_GUILESS_MAIN(KDHockeyApp::TestUploadQueue)
+
+#include "testuploadqueue.moc"